@@ -1,6 +1,12 @@
 #include <tesseract/baseapi.h>
 #include <leptonica/allheaders.h>
+#include "src/PixMemoryPool.h"
+#include "src/Preprocessor.h"
+#include "src/Lexicon.h"
+#include "src/TextCorrector.h"
+#include "src/TrainedData.h"
 #include <iostream>
+#include <algorithm>
 #include <string>
 #include <filesystem>
 #include <queue>
@@ -132,6 +138,8 @@ public:
 // Image preprocessing class 
 class OCRImageCleaner {
 public:
+    explicit OCRImageCleaner(const PreprocessOptions& options) : m_options(options) {}
+    
     Pix* cleanImage(const std::string& inputPath) {
         std::cout << "  Processing: " << fs::path(inputPath).filename() << std::endl;
         
@@ -146,27 +154,16 @@ public:
         pixGetDimensions(pix, &width, &height, &depth);
         std::cout << "  Original: " << width << "x" << height << ", depth: " << depth << std::endl;
 
-        // Convert to grayscale if needed
-        if (depth != 8) {
-            Pix* temp = pixConvertTo8(pix, 0);
-            if (temp) {
-                pixDestroy(&pix);
-                pix = temp;
-            }
-        }
-
-        // Simple noise reduction
-        Pix* denoised = pixMedianFilter(pix, 1, 1);
-        if (denoised) {
-            pixDestroy(&pix);
-            pix = denoised;
+        // Same configurable stages as the server, by default gray
+        // conversion, median filter and a fixed threshold
+        PreprocessInfo info;
+        pix = runPreprocessStages(pix, m_options, info);
+        if (!pix) {
+            std::cerr << "  Error: Preprocessing failed" << std::endl;
+            return nullptr;
         }
-
-        // Simple threshold
-        Pix* binary = pixThresholdToBinary(pix, 128);
-        if (binary) {
-            pixDestroy(&pix);
-            pix = binary;
+        for (const auto& timing : info.stageTimings) {
+            std::cout << "  " << preprocessStageName(timing.stage) << ": " << timing.ms << "ms" << std::endl;
         }
 
         pixGetDimensions(pix, &width, &height, &depth);
@@ -174,64 +171,10 @@ public:
 
         return pix;
     }
-};
 
-std::string postProcessText(const std::string& text) {
-    if (text.empty()) return "";
-    
-    std::string result = text;
-    
-    // Remove leading/trailing whitespace
-    result.erase(0, result.find_first_not_of(" \t\n\r\f\v"));
-    result.erase(result.find_last_not_of(" \t\n\r\f\v") + 1);
-    
-    if (result.empty()) return "";
-    
-    // Common OCR error patterns to fix
-    std::vector<std::pair<std::string, std::string>> replacements = {
-        {"|", "l"},        // Common OCR error: | -> l
-        {"[", "l"},        // [ -> l  
-        {"]", "l"},        // ] -> l
-        {"`", "'"},        // ` -> '
-        {"''", "\""},      // '' -> "
-        {" - ", "-"},      // Remove spaces around hyphens
-        {" ,", ","},       // Fix space before comma
-        {" .", "."},       // Fix space before period
-        {"\\", "l"},       // \ -> l
-        {"//", "l"},       // // -> l
-        {"0", "o"},        // 0 -> o (common misrecognition)
-        {"1", "l"},        // 1 -> l
-        {"5", "s"},        // 5 -> s
-    };
-    
-    // Apply replacements
-    for (const auto& replacement : replacements) {
-        size_t pos = 0;
-        while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
-            result.replace(pos, replacement.first.length(), replacement.second);
-            pos += replacement.second.length();
-        }
-    }
-    
-    // Remove isolated punctuation at start/end
-    if (!result.empty()) {
-        std::string punctuation = ".,!?*-|`'\"";
-        while (!result.empty() && punctuation.find(result[0]) != std::string::npos) {
-            result.erase(0, 1);
-        }
-        while (!result.empty() && punctuation.find(result.back()) != std::string::npos) {
-            result.pop_back();
-        }
-    }
-    
-    // Remove multiple consecutive spaces
-    size_t pos = 0;
-    while ((pos = result.find("  ", pos)) != std::string::npos) {
-        result.replace(pos, 2, " ");
-    }
-    
-    return result;
-}
+private:
+    PreprocessOptions m_options;
+};
 
 // Producer thread function - loads image paths into queue
 void producerThread(const std::string& directoryPath, 
@@ -274,13 +217,24 @@ void workerThread(int workerId,
                  ThreadSafeQueue<std::string>& imageQueue,
                  std::counting_semaphore<>& semaphore,
                  std::atomic<bool>& producerDone,
-                 ResultsManager& resultsManager) {
+                 ResultsManager& resultsManager,
+                 const PreprocessOptions& preprocessOptions,
+                 const TrainedData* model,
+                 const Lexicon* lexicon) {
     
     // Initialize Tesseract OCR engine with better configuration
     tesseract::TessBaseAPI* ocr = new tesseract::TessBaseAPI();
     
-    // Configure Tesseract for better accuracy
-    if (ocr->Init(NULL, "eng")) {
+    // Neural nets only, without the dictionaries: both are read while the
+    // model loads, so they have to be passed to Init
+    std::vector<std::string> initNames = {"load_system_dawg", "load_freq_dawg"};
+    std::vector<std::string> initValues = {"0", "0"};
+    // From the model main() loaded, when it found one
+    int failed = model
+        ? ocr->Init(model->data(), model->size(), "eng", tesseract::OEM_LSTM_ONLY, nullptr, 0,
+                    &initNames, &initValues, false, nullptr)
+        : ocr->Init(NULL, "eng", tesseract::OEM_LSTM_ONLY, nullptr, 0, &initNames, &initValues, false);
+    if (failed) {
         std::cerr << "Worker " << workerId << ": Could not initialize Tesseract" << std::endl;
         delete ocr;
         return;
@@ -289,12 +243,9 @@ void workerThread(int workerId,
     // Set Tesseract parameters for better text recognition
     ocr->SetPageSegMode(tesseract::PSM_SINGLE_WORD); // Treat image as a single word
     ocr->SetVariable("tessedit_char_whitelist", "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"); // Limit to alphanumeric
-    ocr->SetVariable("load_system_dawg", "0"); // Don't load system dictionary
-    ocr->SetVariable("load_freq_dawg", "0");   // Don't load frequent words dictionary
     ocr->SetVariable("textord_min_linesize", "2.0"); // Minimum line size
-    ocr->SetVariable("tessedit_ocr_engine_mode", "1"); // Neural nets only
     
-    OCRImageCleaner cleaner;
+    OCRImageCleaner cleaner(preprocessOptions);
     int processedCount = 0;
     
     std::cout << "Worker " << workerId << ": Started" << std::endl;
@@ -334,14 +285,14 @@ void workerThread(int workerId,
             ocr->SetImage(cleanedImage);
             char* outText = ocr->GetUTF8Text();
             std::string extractedText = outText ? outText : "";
-            extractedText = postProcessText(extractedText);  
             
             // Clean up
             delete[] outText;
             pixDestroy(&cleanedImage);
             
-            // Post-process the extracted text
-            extractedText = postProcessText(extractedText);
+            // Same corrections as the server: digits only become letters
+            // where the lexicon knows the resulting word
+            extractedText = postProcessOCRText(extractedText, lexicon);
             
             auto endTime = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
@@ -370,6 +321,9 @@ void workerThread(int workerId,
 int main(int argc, char* argv[]) {
     std::string inputDir;
     int numWorkers = 2; // Default to 2 worker threads
+    std::string lexiconPath;
+    PreprocessOptions preprocessOptions;
+    preprocessOptions.stages = {PreprocessStage::Convert, PreprocessStage::Denoise, PreprocessStage::Binarize};
     
     // Prompt user for input directory
     if (argc >= 2) {
@@ -377,6 +331,13 @@ int main(int argc, char* argv[]) {
         if (argc >= 3) {
             numWorkers = std::stoi(argv[2]);
         }
+        if (argc >= 4 && !parsePreprocessStages(argv[3], preprocessOptions.stages)) {
+            std::cerr << "Error: Invalid preprocessing stages '" << argv[3] << "'" << std::endl;
+            return 1;
+        }
+        if (argc >= 5) {
+            lexiconPath = argv[4];
+        }
     } else {
         std::cout << "Enter the directory path containing images to process: ";
         std::getline(std::cin, inputDir);
@@ -403,8 +364,27 @@ int main(int argc, char* argv[]) {
     std::cout << "\n=== Starting Multithreaded OCR Pipeline ===" << std::endl;
     std::cout << "Input directory: " << inputDir << std::endl;
     std::cout << "Number of worker threads: " << numWorkers << std::endl;
+    std::cout << "Preprocessing: " << preprocessStagesName(preprocessOptions.stages) << std::endl;
+    std::cout << "Lexicon: " << (lexiconPath.empty() ? "none" : lexiconPath) << std::endl;
     std::cout << "=========================================\n" << std::endl;
     
+    // Reuse page-sized image buffers across images instead of going back
+    // to the heap for every conversion in OCRImageCleaner
+    PixMemoryPool::install();
+    
+    // Read the model once for every worker rather than once per worker
+    std::shared_ptr<const TrainedData> model = TrainedData::load("");
+    
+    // Built with OCRServer --build-lexicon; without one digits are kept
+    std::unique_ptr<Lexicon> lexicon;
+    if (!lexiconPath.empty()) {
+        lexicon = Lexicon::open(lexiconPath);
+        if (!lexicon) {
+            std::cerr << "Error: Cannot open lexicon '" << lexiconPath << "'" << std::endl;
+            return 1;
+        }
+    }
+    
     // Initialize shared resources
     ThreadSafeQueue<std::string> imageQueue;
     std::counting_semaphore<> semaphore(0); // Start with 0, producer will release
@@ -422,7 +402,8 @@ int main(int argc, char* argv[]) {
     for (int i = 0; i < numWorkers; i++) {
         workers.emplace_back(workerThread, i + 1, std::ref(imageQueue), 
                            std::ref(semaphore), std::ref(producerDone), 
-                           std::ref(resultsManager));
+                           std::ref(resultsManager), std::cref(preprocessOptions), model.get(),
+                           lexicon.get());
     }
     
     // Wait for all threads to complete
@@ -0,0 +1,151 @@
+// Compares the fused binarizeGlobal kernel and the tiled adaptive modes
+// against the original pixConvertTo8 + pixThresholdToBinary path on a
+// synthetic color page, and times the blank page check on it and on a
+// blank one. Fails if binarizeGlobal differs from that path in a single
+// pixel, for any color and a range of thresholds.
+#include "ImageKernels.h"
+#include <leptonica/allheaders.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+// Letter-size page at 600 DPI with an uneven background and dark "text" strokes
+static Pix* makeColorPage(l_int32 width, l_int32 height) {
+    Pix* pix = pixCreate(width, height, 32);
+    l_uint32* data = pixGetData(pix);
+    l_int32 wpl = pixGetWpl(pix);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(-12, 12);
+
+    for (l_int32 y = 0; y < height; ++y) {
+        l_uint32* line = data + y * wpl;
+        for (l_int32 x = 0; x < width; ++x) {
+            int base = 200 + (x * 40) / width - (y * 30) / height;
+            bool ink = ((y / 48) % 2 == 0) && ((x / 12) % 5 != 0) && ((x + y) % 7 < 3);
+            int value = ink ? 40 : base;
+            int r = std::clamp(value + noise(rng), 0, 255);
+            int g = std::clamp(value + noise(rng), 0, 255);
+            int b = std::clamp(value - 10 + noise(rng), 0, 255);
+            line[x] = (static_cast<l_uint32>(r) << 24) | (g << 16) | (b << 8);
+        }
+    }
+    return pix;
+}
+
+// Every 24-bit color once, in rows that end in a partial 32-pixel word
+static Pix* makeAllColors() {
+    const l_int32 width = 4113;
+    const l_int32 height = (1 << 24) / width + 1;
+    Pix* pix = pixCreate(width, height, 32);
+    l_uint32* data = pixGetData(pix);
+    l_int32 wpl = pixGetWpl(pix);
+    for (l_int32 y = 0; y < height; ++y) {
+        for (l_int32 x = 0; x < width; ++x) {
+            l_uint32 color = static_cast<l_uint32>(y * width + x) & 0xffffff;
+            data[y * wpl + x] = color << 8;
+        }
+    }
+    return pix;
+}
+
+static l_int32 countDiffering(Pix* pixs, int threshold) {
+    Pix* gray = pixConvertTo8(pixs, 0);
+    Pix* expected = pixThresholdToBinary(gray, threshold);
+    Pix* actual = binarizeGlobal(pixs, threshold);
+    Pix* diff = pixXor(nullptr, expected, actual);
+    l_int32 differing = 0;
+    pixCountPixels(diff, &differing, nullptr);
+    pixDestroy(&diff);
+    pixDestroy(&actual);
+    pixDestroy(&expected);
+    pixDestroy(&gray);
+    return differing;
+}
+
+template<class F>
+static double timeMs(int iterations, F&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = (argc >= 2) ? std::stoi(argv[1]) : 20;
+    const l_int32 width = 5100;
+    const l_int32 height = 6600;
+
+    Pix* page = makeColorPage(width, height);
+    Pix* gray = pixConvertTo8(page, 0);
+
+    std::cout << "Page: " << width << "x" << height << " (32 bpp), " << iterations << " iterations" << std::endl;
+    std::cout << "Kernel: " << binarizeKernelName() << std::endl;
+
+    double legacy32 = timeMs(iterations, [&]() {
+        Pix* eight = pixConvertTo8(page, 0);
+        Pix* binary = pixThresholdToBinary(eight, 128);
+        pixDestroy(&eight);
+        pixDestroy(&binary);
+    });
+    double fused32 = timeMs(iterations, [&]() {
+        Pix* binary = binarizeGlobal(page, 128);
+        pixDestroy(&binary);
+    });
+    double legacy8 = timeMs(iterations, [&]() {
+        Pix* binary = pixThresholdToBinary(gray, 128);
+        pixDestroy(&binary);
+    });
+    double fused8 = timeMs(iterations, [&]() {
+        Pix* binary = binarizeGlobal(gray, 128);
+        pixDestroy(&binary);
+    });
+
+    double otsu = timeMs(iterations, [&]() {
+        Pix* binary = binarizeAdaptive(page, BinarizationMode::Otsu);
+        pixDestroy(&binary);
+    });
+    double sauvola = timeMs(iterations, [&]() {
+        Pix* binary = binarizeAdaptive(page, BinarizationMode::Sauvola);
+        pixDestroy(&binary);
+    });
+
+    Pix* blankPage = pixCreate(width, height, 32);
+    pixSetAllArbitrary(blankPage, 0xf0ece400);
+    InkStatistics pageInk;
+    InkStatistics blankInk;
+    double inkPage = timeMs(iterations, [&]() {
+        measureInk(page, 64, pageInk);
+    });
+    double inkBlank = timeMs(iterations, [&]() {
+        measureInk(blankPage, 64, blankInk);
+    });
+    pixDestroy(&blankPage);
+
+    // Bit for bit, in color and in gray
+    Pix* allColors = makeAllColors();
+    Pix* allGrays = pixConvertTo8(allColors, 0);
+    long long differing = 0;
+    for (int threshold : {1, 64, 127, 128, 200, 255, 256}) {
+        differing += countDiffering(allColors, threshold) + countDiffering(allGrays, threshold);
+    }
+    pixDestroy(&allGrays);
+    pixDestroy(&allColors);
+
+    std::cout << "RGB  convert+threshold: " << legacy32 << " ms, fused: " << fused32 << " ms"
+              << " (" << legacy32 / fused32 << "x)" << std::endl;
+    std::cout << "Gray threshold:         " << legacy8 << " ms, fused: " << fused8 << " ms"
+              << " (" << legacy8 / fused8 << "x)" << std::endl;
+    std::cout << "RGB  tiled Otsu:        " << otsu << " ms, tiled Sauvola: " << sauvola << " ms" << std::endl;
+    std::cout << "Blank check:            " << inkPage * 1000.0 << " us (ink " << pageInk.inkFraction
+              << ", edges " << pageInk.edgeFraction << "), blank page " << inkBlank * 1000.0 << " us (ink "
+              << blankInk.inkFraction << ", edges " << blankInk.edgeFraction << ")" << std::endl;
+    std::cout << "Pixels differing from reference, all colors and thresholds: " << differing << std::endl;
+
+    pixDestroy(&gray);
+    pixDestroy(&page);
+    return differing == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,246 @@
+// Runs every image in a corpus directory through OCRProcessor under a few
+// preprocessing configurations and reports throughput and, where a
+// <stem>.gt.txt ground truth file sits next to the image, character
+// accuracy (1 - edit distance / ground truth length). Images whose
+// orientation preprocessing can't settle are counted as taking the OSD path,
+// and images whose fast recognition pass wasn't confident enough as
+// escalated.
+//
+// Usage: CorpusBench <corpus-dir> [binarization] [stage-list ...]
+//
+// Each stage list (e.g. convert,denoise,binarize) replaces the built-in
+// configurations and is reported with its average time per stage.
+#include "OCRProcessor.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+
+namespace fs = std::filesystem;
+
+struct CorpusImage {
+    std::string filename;
+    std::string data;
+    std::string groundTruth;
+    bool hasGroundTruth = false;
+};
+
+static bool readFile(const fs::path& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+static std::vector<CorpusImage> loadCorpus(const fs::path& directory) {
+    std::vector<CorpusImage> corpus;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" &&
+            extension != ".tif" && extension != ".tiff" && extension != ".bmp") {
+            continue;
+        }
+
+        CorpusImage image;
+        image.filename = entry.path().filename().string();
+        if (!readFile(entry.path(), image.data)) {
+            std::cerr << "Could not read " << entry.path() << std::endl;
+            continue;
+        }
+        fs::path truthPath = entry.path();
+        truthPath.replace_extension(".gt.txt");
+        image.hasGroundTruth = readFile(truthPath, image.groundTruth);
+        corpus.push_back(std::move(image));
+    }
+    std::sort(corpus.begin(), corpus.end(),
+              [](const CorpusImage& a, const CorpusImage& b) { return a.filename < b.filename; });
+    return corpus;
+}
+
+// Whitespace differences aren't recognition errors
+static std::string normalizeWhitespace(const std::string& text) {
+    std::string result;
+    bool pendingSpace = false;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = !result.empty();
+        } else {
+            if (pendingSpace) {
+                result += ' ';
+                pendingSpace = false;
+            }
+            result += c;
+        }
+    }
+    return result;
+}
+
+static size_t editDistance(const std::string& a, const std::string& b) {
+    std::vector<size_t> previous(b.size() + 1), current(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        current[0] = i;
+        for (size_t j = 1; j <= b.size(); ++j) {
+            size_t substitution = previous[j - 1] + (a[i - 1] != b[j - 1] ? 1 : 0);
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution});
+        }
+        std::swap(previous, current);
+    }
+    return previous[b.size()];
+}
+
+static void runConfiguration(const std::string& name, const PreprocessOptions& options,
+                             const std::vector<CorpusImage>& corpus, OCRProcessor& processor) {
+    double decodeMs = 0.0;
+    double recognizeMs = 0.0;
+    size_t truthChars = 0;
+    size_t errors = 0;
+    size_t osdImages = 0;
+    size_t escalated = 0;
+    size_t blank = 0;
+    std::map<PreprocessStage, double> stageMs;
+
+    for (const auto& image : corpus) {
+        auto start = std::chrono::high_resolution_clock::now();
+        PreprocessInfo info;
+        Pix* pix = OCRProcessor::decodeImage(image.data, image.filename, options, &info);
+        auto decoded = std::chrono::high_resolution_clock::now();
+        std::string text;
+        if (pix) {
+            if (info.needsOSD) {
+                osdImages++;
+            }
+            CascadeResult cascade;
+            text = processor.recognize(pix, image.filename, info.pageSegMode(), info.textHeight, &cascade);
+            if (cascade.escalated) {
+                escalated++;
+            }
+            pixDestroy(&pix);
+        } else if (info.noText) {
+            blank++;
+        }
+        auto recognized = std::chrono::high_resolution_clock::now();
+
+        decodeMs += std::chrono::duration<double, std::milli>(decoded - start).count();
+        for (const auto& timing : info.stageTimings) {
+            stageMs[timing.stage] += timing.ms;
+        }
+        recognizeMs += std::chrono::duration<double, std::milli>(recognized - decoded).count();
+
+        if (image.hasGroundTruth) {
+            std::string expected = normalizeWhitespace(image.groundTruth);
+            truthChars += expected.size();
+            errors += editDistance(normalizeWhitespace(text), expected);
+        }
+    }
+
+    double count = static_cast<double>(corpus.size());
+    std::cout << name << ": " << (decodeMs + recognizeMs) / count << " ms/image"
+              << " (preprocess " << decodeMs / count << ", recognize " << recognizeMs / count << ")"
+              << ", OSD on " << osdImages << "/" << corpus.size()
+              << ", escalated " << escalated << "/" << corpus.size()
+              << ", rejected as blank " << blank << "/" << corpus.size();
+    if (truthChars > 0) {
+        double accuracy = 100.0 * (1.0 - static_cast<double>(std::min(errors, truthChars)) / truthChars);
+        std::cout << ", character accuracy " << accuracy << "%";
+    }
+    std::cout << std::endl;
+    for (PreprocessStage stage : options.stages) {
+        if (stageMs.count(stage)) {
+            std::cout << "    " << preprocessStageName(stage) << ": " << stageMs[stage] / count << " ms/image" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <corpus-dir> [global|otsu|sauvola] [stage-list ...]" << std::endl;
+        return 1;
+    }
+
+    BinarizationMode binarization = BinarizationMode::Global;
+    if (argc >= 3) {
+        binarization = parseBinarizationMode(argv[2]);
+        if (binarization == BinarizationMode::Default) {
+            std::cerr << "Unknown binarization mode: " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<CorpusImage> corpus = loadCorpus(argv[1]);
+    if (corpus.empty()) {
+        std::cerr << "No images found in " << argv[1] << std::endl;
+        return 1;
+    }
+    size_t withTruth = std::count_if(corpus.begin(), corpus.end(),
+                                     [](const CorpusImage& image) { return image.hasGroundTruth; });
+    std::cout << "Corpus: " << corpus.size() << " images, " << withTruth << " with ground truth" << std::endl;
+
+    // Warmed up, so the first configuration doesn't pay for Tesseract's
+    // first-use allocations
+    OCRProcessor processor;
+    if (!processor.initialize()) {
+        return 1;
+    }
+    std::cout << "Warm-up: " << processor.warmUp() << " ms" << std::endl;
+
+    if (argc >= 4) {
+        for (int i = 3; i < argc; ++i) {
+            PreprocessOptions options;
+            options.binarization = binarization;
+            if (!parsePreprocessStages(argv[i], options.stages)) {
+                std::cerr << "Invalid stage list: " << argv[i] << std::endl;
+                return 1;
+            }
+            runConfiguration(argv[i], options, corpus, processor);
+        }
+        return 0;
+    }
+
+    PreprocessOptions original;
+    original.binarization = binarization;
+    original.rescale = false;
+    runConfiguration("original size", original, corpus, processor);
+
+    // Every image straight to the full configuration
+    OCRProcessor fullProcessor;
+    CascadeOptions noCascade;
+    noCascade.enabled = false;
+    if (fullProcessor.initialize(*findProfile(""), noCascade)) {
+        fullProcessor.warmUp();
+        PreprocessOptions defaults;
+        defaults.binarization = binarization;
+        runConfiguration("no cascade", defaults, corpus, fullProcessor);
+    }
+
+    PreprocessOptions alwaysOsd;
+    alwaysOsd.binarization = binarization;
+    alwaysOsd.fastOrientation = false;
+    runConfiguration("always OSD", alwaysOsd, corpus, processor);
+
+    PreprocessOptions noCrop;
+    noCrop.binarization = binarization;
+    noCrop.cropToText = false;
+    runConfiguration("no text crop", noCrop, corpus, processor);
+
+    for (int height : {20, 24, 32}) {
+        PreprocessOptions rescaled;
+        rescaled.binarization = binarization;
+        rescaled.targetTextHeight = height;
+        runConfiguration("text height " + std::to_string(height), rescaled, corpus, processor);
+    }
+
+    return 0;
+}
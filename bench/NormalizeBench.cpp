@@ -0,0 +1,90 @@
+// Compares normalizeText + stripEdgePunctuation with the trim, repeated
+// find("  ") collapse and punctuation strip both post-processors used to
+// do, on synthetic OCR output with and without typographic quotes.
+#include "TextNormalizer.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// What OCRProcessor and the batch tool each did, minus their replacements
+static std::string legacyNormalize(const std::string& text) {
+    std::string result = text;
+    result.erase(0, result.find_first_not_of(" \t\n\r\f\v"));
+    result.erase(result.find_last_not_of(" \t\n\r\f\v") + 1);
+
+    std::string punctuation = ".,!?*-|`'\"";
+    while (!result.empty() && punctuation.find(result[0]) != std::string::npos) {
+        result.erase(0, 1);
+    }
+    while (!result.empty() && punctuation.find(result.back()) != std::string::npos) {
+        result.pop_back();
+    }
+
+    size_t pos = 0;
+    while ((pos = result.find("  ", pos)) != std::string::npos) {
+        result.erase(pos, 1);
+    }
+    return result;
+}
+
+static std::string makePage(std::mt19937& rng, size_t bytes, bool typographic) {
+    static const char* WORDS[] = {
+        "invoice", "total", "the", "amount", "of", "customer", "number", "10045", "date", "page", "due"
+    };
+    static const char* QUOTED[] = {"“quoted”", "it’s", "„low”", "‘single’"};
+    std::uniform_int_distribution<size_t> word(0, std::size(WORDS) - 1);
+    std::uniform_int_distribution<size_t> quoted(0, std::size(QUOTED) - 1);
+    std::uniform_int_distribution<int> roll(0, 99);
+
+    std::string page = "  ";
+    while (page.size() < bytes) {
+        page += (typographic && roll(rng) < 5) ? QUOTED[quoted(rng)] : WORDS[word(rng)];
+        int separator = roll(rng);
+        page += separator < 80 ? " " : separator < 90 ? "  " : separator < 97 ? "\n" : ",   ";
+    }
+    return page;
+}
+
+template<class F>
+static double timeMs(int iterations, F&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = (argc >= 2) ? std::stoi(argv[1]) : 2000;
+    const size_t PAGE_BYTES = 4000;
+
+    std::mt19937 rng(42);
+    std::cout << "Kernel: " << normalizeKernelName() << ", " << PAGE_BYTES << "-byte pages, "
+              << iterations << " iterations" << std::endl;
+
+    size_t sink = 0;
+    for (bool typographic : {false, true}) {
+        std::string page = makePage(rng, PAGE_BYTES, typographic);
+        std::string normalized;
+
+        double legacyMs = timeMs(iterations, [&]() {
+            sink += legacyNormalize(page).size();
+        });
+        double sharedMs = timeMs(iterations, [&]() {
+            normalizeText(page, normalized);
+            stripEdgePunctuation(normalized);
+            sink += normalized.size();
+        });
+
+        // Quotes are folded now, so only the ASCII page can match exactly
+        bool matches = normalized == legacyNormalize(page);
+        std::cout << (typographic ? "With quotes: " : "ASCII:       ")
+                  << "find loops " << legacyMs * 1000.0 << " us, shared " << sharedMs * 1000.0 << " us ("
+                  << legacyMs / sharedMs << "x, " << page.size() / (sharedMs * 1000.0) << " MB/s)"
+                  << (typographic ? "" : matches ? ", output matches" : ", OUTPUT DIFFERS") << std::endl;
+    }
+    return sink == 0 ? 1 : 0;
+}
\ No newline at end of file
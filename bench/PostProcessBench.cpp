@@ -0,0 +1,312 @@
+// Compares the single-pass TextCorrector behind postProcessOCRText with the
+// original one-std::string::find-loop-per-rule postProcessText on synthetic
+// full-page OCR output, with and without a lexicon, and checks that numbers
+// survive correction.
+#include "TextCorrector.h"
+#include "Lexicon.h"
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The original implementation, kept verbatim as the reference
+namespace legacy {
+
+static std::string applyContextualReplacements(const std::string& text) {
+    if (text.length() <= 1) return text;
+
+    std::string result = text;
+
+    for (size_t i = 0; i < result.length(); ++i) {
+        char c = result[i];
+        if (c == '0' && (i == 0 || !std::isalnum(result[i-1]))) {
+            result[i] = 'O';
+        }
+        else if (c == '1' && i > 0 && i < result.length()-1 &&
+                 std::isalpha(result[i-1]) && std::isalpha(result[i+1])) {
+            result[i] = 'l';
+        }
+        else if (c == '5' && i < result.length()-1 && std::isalpha(result[i+1])) {
+            result[i] = 'S';
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> wordReplacements = {
+        {"lhe", "the"}, {"lhat", "that"}, {"lhis", "this"}, {"lhere", "there"},
+        {"wi1h", "with"}, {"1he", "the"}, {"0r", "Or"}, {"5tart", "Start"},
+        {"8ack", "Back"}, {"9ood", "good"}, {"6reat", "Great"}
+    };
+
+    for (const auto& replacement : wordReplacements) {
+        size_t pos = 0;
+        while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
+            if ((pos == 0 || !std::isalnum(result[pos-1])) &&
+                (pos + replacement.first.length() >= result.length() ||
+                 !std::isalnum(result[pos + replacement.first.length()]))) {
+                result.replace(pos, replacement.first.length(), replacement.second);
+                pos += replacement.second.length();
+            } else {
+                pos += replacement.first.length();
+            }
+        }
+    }
+
+    return result;
+}
+
+static bool isLikelyGarbage(const std::string& text) {
+    if (text.empty() || text.length() > 100) return false;
+
+    int letterCount = 0;
+    int digitCount = 0;
+    int symbolCount = 0;
+    int consecutiveSymbols = 0;
+    int maxConsecutiveSymbols = 0;
+
+    for (char c : text) {
+        if (std::isalpha(c)) {
+            letterCount++;
+            consecutiveSymbols = 0;
+        } else if (std::isdigit(c)) {
+            digitCount++;
+            consecutiveSymbols = 0;
+        } else if (!std::isspace(c)) {
+            symbolCount++;
+            consecutiveSymbols++;
+            maxConsecutiveSymbols = std::max(maxConsecutiveSymbols, consecutiveSymbols);
+        } else {
+            consecutiveSymbols = 0;
+        }
+    }
+
+    if (symbolCount > letterCount + digitCount) return true;
+    if (maxConsecutiveSymbols >= 3) return true;
+    if (text.length() < 5 && symbolCount >= 2) return true;
+    return false;
+}
+
+static std::string postProcessText(const std::string& text) {
+    if (text.empty()) return "";
+
+    std::string result = text;
+
+    size_t start = result.find_first_not_of(" \t\n\r\f\v");
+    if (start == std::string::npos) return "";
+    size_t end = result.find_last_not_of(" \t\n\r\f\v");
+    result = result.substr(start, end - start + 1);
+
+    if (result.empty()) return "";
+
+    std::vector<std::pair<std::string, std::string>> replacements = {
+        {"|", "l"}, {"[", "l"}, {"]", "l"}, {"\\", "l"}, {"//", "l"},
+        {"``", "\""}, {"''", "\""}, {"`", "'"}, {"´", "'"}, {"‘", "'"}, {"’", "'"},
+        {"“", "\""}, {"”", "\""}, {"„", "\""},
+        {"0", "O"}, {"1", "l"}, {"5", "S"}, {"8", "B"}, {"6", "G"}, {"9", "g"},
+        {" ,", ","}, {" .", "."}, {" ;", ";"}, {" :", ":"},
+        {"( ", "("}, {" )", ")"}, {"[ ", "["}, {" ]", "]"},
+        {"{ ", "{"}, {" }", "}"}, {" /", "/"}, {"\\ ", "\\"}
+    };
+
+    for (const auto& replacement : replacements) {
+        size_t pos = 0;
+        while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
+            result.replace(pos, replacement.first.length(), replacement.second);
+            pos += replacement.second.length();
+        }
+    }
+
+    result = applyContextualReplacements(result);
+
+    if (!result.empty()) {
+        std::string punctuation = ".,!?*-|`'\"";
+        while (!result.empty() && punctuation.find(result[0]) != std::string::npos) {
+            result.erase(0, 1);
+        }
+        while (!result.empty() && punctuation.find(result.back()) != std::string::npos) {
+            result.pop_back();
+        }
+    }
+
+    size_t pos = 0;
+    while ((pos = result.find("  ", pos)) != std::string::npos) {
+        result.replace(pos, 2, " ");
+        pos += 1;
+    }
+
+    if (isLikelyGarbage(result)) {
+        return "";
+    }
+
+    return result;
+}
+
+} // namespace legacy
+
+// Prose with the confusions Tesseract typically makes sprinkled in
+static const char* VOCABULARY[] = {
+    "the", "lhe", "|he", "that", "lhat", "this", "1his", "there", "lhere", "with",
+    "invoice", "total", "amount", "due", "date", "page", "number", "customer", "address",
+    "order", "0rder", "5tart", "8ack", "9ood", "6reat", "ca||", "wi1h", "2024", "15.00",
+    "“quoted”", "it’s", "``tick''", "a/b", "(note", "end)", "{x", "y}", "[item]", "path\\to",
+    "INV-10045", "10045", "1nvoice", "T0TAL", "PO-5568"
+};
+
+static const char* WORDS[] = {
+    "the", "that", "this", "there", "with", "invoice", "total", "amount", "due", "date", "page",
+    "number", "customer", "address", "order", "start", "back", "good", "great", "call", "it",
+    "tick", "note", "end", "item", "path", "to", "quoted", "x", "y", "a", "b"
+};
+
+static std::string makePage(std::mt19937& rng, int words) {
+    static const char* SEPARATORS[] = {" ", " ", " ", " ", " ", ", ", " , ", ". ", " . ", "\n", " ; ", " : ", "( "};
+
+    std::uniform_int_distribution<size_t> word(0, std::size(VOCABULARY) - 1);
+    std::uniform_int_distribution<size_t> separator(0, std::size(SEPARATORS) - 1);
+
+    std::string page;
+    for (int i = 0; i < words; ++i) {
+        page += VOCABULARY[word(rng)];
+        page += SEPARATORS[separator(rng)];
+    }
+    return page;
+}
+
+// Real dictionaries have ~100k entries; pad the vocabulary with made-up
+// words so lookups miss the cache the way they would in production
+static std::vector<std::string> makeLexiconWords(std::mt19937& rng) {
+    std::vector<std::string> words(std::begin(WORDS), std::end(WORDS));
+    std::uniform_int_distribution<int> length(3, 12);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    while (words.size() < 100000) {
+        std::string word(length(rng), 'a');
+        for (char& c : word) {
+            c = static_cast<char>(letter(rng));
+        }
+        words.push_back(word);
+    }
+    return words;
+}
+
+static size_t countOccurrences(const std::string& text, const std::string& token) {
+    size_t count = 0;
+    for (size_t pos = text.find(token); pos != std::string::npos; pos = text.find(token, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+template<class F>
+static double timeMs(int iterations, F&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = (argc >= 2) ? std::stoi(argv[1]) : 200;
+    const int PAGES = 16;
+    const int WORDS_PER_PAGE = 500;
+
+    std::mt19937 rng(42);
+    std::vector<std::string> pages;
+    size_t bytes = 0;
+    for (int i = 0; i < PAGES; ++i) {
+        pages.push_back(makePage(rng, WORDS_PER_PAGE));
+        bytes += pages.back().size();
+    }
+
+    std::string lexiconPath = (std::filesystem::temp_directory_path() / "PostProcessBench.lex").string();
+    if (!Lexicon::build(makeLexiconWords(rng), lexiconPath)) {
+        return 1;
+    }
+    std::unique_ptr<Lexicon> lexicon = Lexicon::open(lexiconPath);
+    if (!lexicon) {
+        return 1;
+    }
+
+    std::cout << PAGES << " pages, " << bytes / PAGES << " bytes/page, " << iterations << " iterations, "
+              << lexicon->size() << "-word lexicon" << std::endl;
+
+    size_t sink = 0;
+    double legacyMs = timeMs(iterations, [&]() {
+        for (const std::string& page : pages) {
+            sink += legacy::postProcessText(page).size();
+        }
+    });
+    double compiledMs = timeMs(iterations, [&]() {
+        for (const std::string& page : pages) {
+            sink += postProcessOCRText(page).size();
+        }
+    });
+    double lexiconMs = timeMs(iterations, [&]() {
+        for (const std::string& page : pages) {
+            sink += postProcessOCRText(page, lexicon.get()).size();
+        }
+    });
+
+    // Numbers must survive; digits inside words should become letters
+    size_t numbersIn = 0;
+    size_t numbersLegacy = 0;
+    size_t numbersKept = 0;
+    long wordsFixed = 0;
+    for (const std::string& page : pages) {
+        std::string legacyText = legacy::postProcessText(page);
+        std::string corrected = postProcessOCRText(page, lexicon.get());
+        for (const char* number : {"2024", "15.00", "10045", "5568"}) {
+            numbersIn += countOccurrences(page, number);
+            numbersLegacy += countOccurrences(legacyText, number);
+            numbersKept += countOccurrences(corrected, number);
+        }
+        for (const char* word : {"order", "invoice", "TOTAL", "start"}) {
+            wordsFixed += static_cast<long>(countOccurrences(corrected, word)) -
+                          static_cast<long>(countOccurrences(page, word));
+        }
+    }
+
+    // Without digits the rules are unchanged, so the outputs must match.
+    // Short inputs exercise the trimming and garbage checks.
+    int compared = 0;
+    int differing = 0;
+    std::string firstDifference;
+    for (int i = 0; i < 1000; ++i) {
+        std::string snippet = makePage(rng, 1 + i % 4);
+        if (snippet.find_first_of("0123456789") != std::string::npos) {
+            continue;
+        }
+        compared++;
+        if (legacy::postProcessText(snippet) != postProcessOCRText(snippet, lexicon.get())) {
+            if (firstDifference.empty()) {
+                firstDifference = snippet;
+            }
+            differing++;
+        }
+    }
+
+    double perPageLegacy = legacyMs / PAGES;
+    double perPageCompiled = compiledMs / PAGES;
+    double perPageLexicon = lexiconMs / PAGES;
+    std::cout << "Per-rule find loops: " << perPageLegacy << " ms/page ("
+              << (bytes / PAGES) / (perPageLegacy * 1000.0) << " MB/s)" << std::endl;
+    std::cout << "Compiled automaton:  " << perPageCompiled << " ms/page ("
+              << (bytes / PAGES) / (perPageCompiled * 1000.0) << " MB/s, "
+              << perPageLegacy / perPageCompiled << "x)" << std::endl;
+    std::cout << "  with lexicon:      " << perPageLexicon << " ms/page" << std::endl;
+    std::cout << "Numbers intact: " << numbersKept << " of " << numbersIn
+              << " (per-rule find loops: " << numbersLegacy << "), words corrected: " << wordsFixed << std::endl;
+    std::cout << "Digit-free outputs differing from reference: " << differing << " of " << compared << std::endl;
+    if (!firstDifference.empty()) {
+        std::cout << "  e.g. \"" << firstDifference << "\"" << std::endl;
+    }
+
+    std::filesystem::remove(lexiconPath);
+    return sink == 0 ? 1 : 0;
+}
\ No newline at end of file
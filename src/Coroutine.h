@@ -0,0 +1,185 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "ThreadPool.h"
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <deque>
+#include <atomic>
+
+// Fire-and-forget coroutine. Starts running immediately and frees its own
+// frame when it finishes, so callers don't keep a handle to it.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            try {
+                std::rethrow_exception(std::current_exception());
+            } catch (const std::exception& e) {
+                std::cerr << "Unhandled exception in detached coroutine: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Unhandled exception in detached coroutine" << std::endl;
+            }
+        }
+    };
+};
+
+// Lazily started coroutine that resumes its awaiter when it finishes
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+    void await_resume() {
+        if (m_handle.promise().exception) {
+            std::rethrow_exception(m_handle.promise().exception);
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Counting semaphore whose acquire() suspends the coroutine instead of
+// blocking the thread. Waiters are resumed on the given pool.
+class AsyncSemaphore {
+public:
+    AsyncSemaphore(size_t count, ThreadPool& resumeOn)
+        : m_count(count)
+        , m_resumeOn(resumeOn) {
+    }
+
+    auto acquire() {
+        struct Awaiter {
+            AsyncSemaphore& semaphore;
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> lock(semaphore.m_mutex);
+                if (semaphore.m_count > 0) {
+                    semaphore.m_count--;
+                    return false;
+                }
+                semaphore.m_waiters.push_back(handle);
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // Takes a permit only if one is free right now
+    bool tryAcquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == 0) {
+            return false;
+        }
+        m_count--;
+        return true;
+    }
+
+    void release() {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_waiters.empty()) {
+                m_count++;
+                return;
+            }
+            waiter = m_waiters.front();
+            m_waiters.pop_front();
+        }
+        // The permit passes straight to the waiter
+        m_resumeOn.post(waiter);
+    }
+
+private:
+    std::mutex m_mutex;
+    size_t m_count;
+    std::deque<std::coroutine_handle<>> m_waiters;
+    ThreadPool& m_resumeOn;
+};
+
+// Runs tasks concurrently; co_await group.wait() resumes once every
+// spawned task has finished. The waiter continues on whichever thread
+// finished the last task. Exceptions are logged, not propagated.
+class TaskGroup {
+public:
+    void spawn(Task task) {
+        m_remaining++;
+        run(std::move(task));
+    }
+
+    auto wait() {
+        struct Awaiter {
+            TaskGroup& group;
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) noexcept {
+                group.m_waiter = handle;
+                // Drop the waiter's own count; suspend unless everything is done
+                return group.m_remaining.fetch_sub(1) != 1;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+private:
+    DetachedTask run(Task task) {
+        try {
+            co_await task;
+        } catch (const std::exception& e) {
+            std::cerr << "Exception in grouped task: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Unknown exception in grouped task" << std::endl;
+        }
+        if (m_remaining.fetch_sub(1) == 1) {
+            m_waiter.resume();
+        }
+    }
+
+    std::atomic<size_t> m_remaining{1};     // One extra for the waiter
+    std::coroutine_handle<> m_waiter;
+};
+
+#endif // COROUTINE_H
\ No newline at end of file
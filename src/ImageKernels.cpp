@@ -0,0 +1,1090 @@
+#include "ImageKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OCR_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define OCR_TARGET_AVX2
+#else
+#define OCR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// pixConvertRGBToLuminance computes (int)(0.3f r + 0.5f g + 0.2f b + 0.5)
+// in float, which for 8-bit channels is exactly (3r + 5g + 2b + 5) / 10 in
+// integers (checked over all 2^24 colors). The gray value is below
+// threshold exactly when 3r + 5g + 2b < threshold * 10 - 5.
+static const int RED_WEIGHT = 3;
+static const int GREEN_WEIGHT = 5;
+static const int BLUE_WEIGHT = 2;
+
+static inline int weightedLimit(int threshold) {
+    return threshold * 10 - 5;
+}
+
+typedef void (*ThresholdRowFn)(const l_uint32* src, l_uint32* dst, int width, int threshold);
+
+static inline l_uint32 weightedSum(l_uint32 pixel) {
+    return (pixel >> 24) * RED_WEIGHT
+         + ((pixel >> 16) & 0xff) * GREEN_WEIGHT
+         + ((pixel >> 8) & 0xff) * BLUE_WEIGHT;
+}
+
+// Leptonica stores 1 bpp pixels MSB first, while SIMD movemasks put the
+// first pixel in bit 0
+static inline l_uint32 reverseBits(l_uint32 x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    return (x >> 24) | ((x >> 8) & 0xff00u) | ((x << 8) & 0xff0000u) | (x << 24);
+}
+
+// 8 bpp words hold four pixels MSB first, so on little-endian memory each
+// group of four bytes is reversed. A byte-order movemask therefore needs
+// its nibbles reversed, not its bits.
+static inline l_uint32 reverseNibbles(l_uint32 x) {
+    x = (x >> 24) | ((x >> 8) & 0xff00u) | ((x << 8) & 0xff0000u) | (x << 24);
+    return ((x & 0x0f0f0f0fu) << 4) | ((x >> 4) & 0x0f0f0f0fu);
+}
+
+// ===== Scalar kernels =====
+
+static void thresholdRow32Scalar(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    const l_uint32 limit = static_cast<l_uint32>(weightedLimit(threshold));
+    int words = (width + 31) / 32;
+    for (int w = 0; w < words; ++w) {
+        int count = std::min(32, width - w * 32);
+        l_uint32 bits = 0;
+        for (int k = 0; k < count; ++k) {
+            if (weightedSum(src[w * 32 + k]) < limit) {
+                bits |= 0x80000000u >> k;
+            }
+        }
+        dst[w] = bits;
+    }
+}
+
+static void thresholdRow8Scalar(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    int words = (width + 31) / 32;
+    for (int w = 0; w < words; ++w) {
+        int count = std::min(32, width - w * 32);
+        l_uint32 bits = 0;
+        for (int k = 0; k < count; ++k) {
+            if (static_cast<int>(GET_DATA_BYTE(src, w * 32 + k)) < threshold) {
+                bits |= 0x80000000u >> k;
+            }
+        }
+        dst[w] = bits;
+    }
+}
+
+#ifdef OCR_KERNELS_X86
+
+// ===== SSE2 kernels (baseline on x86-64) =====
+
+static void thresholdRow32Sse2(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    // Split each pixel into 16-bit lanes (A, G) and (B, R) so one madd per
+    // pair gives the weighted sum
+    const __m128i byteMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i weightsAG = _mm_set1_epi32(GREEN_WEIGHT << 16);
+    const __m128i weightsBR = _mm_set1_epi32((RED_WEIGHT << 16) | BLUE_WEIGHT);
+    const __m128i limit = _mm_set1_epi32(weightedLimit(threshold));
+
+    int fullWords = width / 32;
+    for (int w = 0; w < fullWords; ++w) {
+        l_uint32 mask = 0;
+        for (int k = 0; k < 32; k += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + w * 32 + k));
+            __m128i ag = _mm_and_si128(v, byteMask);
+            __m128i br = _mm_and_si128(_mm_srli_epi32(v, 8), byteMask);
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(ag, weightsAG), _mm_madd_epi16(br, weightsBR));
+            __m128i dark = _mm_cmplt_epi32(sum, limit);
+            mask |= static_cast<l_uint32>(_mm_movemask_ps(_mm_castsi128_ps(dark))) << k;
+        }
+        dst[w] = reverseBits(mask);
+    }
+
+    if (width > fullWords * 32) {
+        thresholdRow32Scalar(src + fullWords * 32, dst + fullWords, width - fullWords * 32, threshold);
+    }
+}
+
+static void thresholdRow8Sse2(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    // v < threshold  <=>  min(v, threshold - 1) == v, with threshold in [1, 256]
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold - 1));
+
+    int fullWords = width / 32;
+    for (int w = 0; w < fullWords; ++w) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(src + w * 8);
+        __m128i lo = _mm_loadu_si128(p);
+        __m128i hi = _mm_loadu_si128(p + 1);
+        l_uint32 mask = static_cast<l_uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(lo, limit), lo)))
+                      | static_cast<l_uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(hi, limit), hi))) << 16;
+        dst[w] = reverseNibbles(mask);
+    }
+
+    if (width > fullWords * 32) {
+        thresholdRow8Scalar(src + fullWords * 8, dst + fullWords, width - fullWords * 32, threshold);
+    }
+}
+
+// ===== AVX2 kernels =====
+
+OCR_TARGET_AVX2
+static void thresholdRow32Avx2(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    const __m256i byteMask = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i weightsAG = _mm256_set1_epi32(GREEN_WEIGHT << 16);
+    const __m256i weightsBR = _mm256_set1_epi32((RED_WEIGHT << 16) | BLUE_WEIGHT);
+    const __m256i limit = _mm256_set1_epi32(weightedLimit(threshold));
+
+    int fullWords = width / 32;
+    for (int w = 0; w < fullWords; ++w) {
+        l_uint32 mask = 0;
+        for (int k = 0; k < 32; k += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + w * 32 + k));
+            __m256i ag = _mm256_and_si256(v, byteMask);
+            __m256i br = _mm256_and_si256(_mm256_srli_epi32(v, 8), byteMask);
+            __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(ag, weightsAG), _mm256_madd_epi16(br, weightsBR));
+            __m256i dark = _mm256_cmpgt_epi32(limit, sum);
+            mask |= static_cast<l_uint32>(_mm256_movemask_ps(_mm256_castsi256_ps(dark))) << k;
+        }
+        dst[w] = reverseBits(mask);
+    }
+
+    if (width > fullWords * 32) {
+        thresholdRow32Scalar(src + fullWords * 32, dst + fullWords, width - fullWords * 32, threshold);
+    }
+}
+
+OCR_TARGET_AVX2
+static void thresholdRow8Avx2(const l_uint32* src, l_uint32* dst, int width, int threshold) {
+    const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold - 1));
+
+    int fullWords = width / 32;
+    for (int w = 0; w < fullWords; ++w) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + w * 8));
+        __m256i dark = _mm256_cmpeq_epi8(_mm256_min_epu8(v, limit), v);
+        dst[w] = reverseNibbles(static_cast<l_uint32>(_mm256_movemask_epi8(dark)));
+    }
+
+    if (width > fullWords * 32) {
+        thresholdRow8Scalar(src + fullWords * 8, dst + fullWords, width - fullWords * 32, threshold);
+    }
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // OCR_KERNELS_X86
+
+struct ThresholdKernels {
+    ThresholdRowFn row32;
+    ThresholdRowFn row8;
+    const char* name;
+};
+
+static ThresholdKernels selectKernels() {
+#ifdef OCR_KERNELS_X86
+    if (cpuHasAvx2()) {
+        return {thresholdRow32Avx2, thresholdRow8Avx2, "avx2"};
+    }
+    return {thresholdRow32Sse2, thresholdRow8Sse2, "sse2"};
+#else
+    return {thresholdRow32Scalar, thresholdRow8Scalar, "scalar"};
+#endif
+}
+
+static const ThresholdKernels& kernels() {
+    static const ThresholdKernels selected = selectKernels();
+    return selected;
+}
+
+const char* binarizeKernelName() {
+    return kernels().name;
+}
+
+Pix* binarizeGlobal(Pix* pixs, int threshold) {
+    if (!pixs) {
+        return nullptr;
+    }
+
+    Pix* source = nullptr;
+    l_int32 depth = pixGetDepth(pixs);
+    if (depth == 32 || (depth == 8 && !pixGetColormap(pixs))) {
+        source = pixClone(pixs);
+    } else {
+        // Colormaps and low bit depths are rare enough to take the slow path
+        source = pixConvertTo8(pixs, 0);
+        if (!source) {
+            return nullptr;
+        }
+        depth = pixGetDepth(source);
+        if (depth != 8 || pixGetColormap(source)) {
+            Pix* binary = pixThresholdToBinary(source, threshold);
+            pixDestroy(&source);
+            return binary;
+        }
+    }
+
+    l_int32 width, height;
+    pixGetDimensions(source, &width, &height, nullptr);
+    Pix* binary = pixCreateNoInit(width, height, 1);
+    if (!binary) {
+        pixDestroy(&source);
+        return nullptr;
+    }
+    pixCopyResolution(binary, source);
+
+    // Every output word is written, padding bits included
+    threshold = std::clamp(threshold, 0, 256);
+    if (threshold == 0) {
+        pixClearAll(binary);
+    } else {
+        ThresholdRowFn row = (depth == 32) ? kernels().row32 : kernels().row8;
+        l_uint32* srcData = pixGetData(source);
+        l_uint32* dstData = pixGetData(binary);
+        l_int32 srcWpl = pixGetWpl(source);
+        l_int32 dstWpl = pixGetWpl(binary);
+        for (l_int32 y = 0; y < height; ++y) {
+            row(srcData + y * srcWpl, dstData + y * dstWpl, width, threshold);
+        }
+    }
+
+    pixDestroy(&source);
+    return binary;
+}
+
+// ===== Adaptive thresholding =====
+
+// Tiles narrower than the image are multiples of 32 pixels wide, so no two
+// tiles ever write to the same 1 bpp output word
+struct TileGrid {
+    int width;
+    int height;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+
+    int count() const { return tilesX * tilesY; }
+    int x0(int tile) const { return (tile % tilesX) * tileSize; }
+    int y0(int tile) const { return (tile / tilesX) * tileSize; }
+    int x1(int tile) const { return std::min(x0(tile) + tileSize, width); }
+    int y1(int tile) const { return std::min(y0(tile) + tileSize, height); }
+};
+
+// Helpers for parallelForTiles, shared by every caller so that concurrent
+// binarizations (one per recognizer thread) together never use more than
+// a thread per core. Created on first use, so a process that forks before
+// it binarizes anything (OCRServer's zygote) has no threads to lose.
+static ThreadPool& tilePool() {
+    static ThreadPool* pool = new ThreadPool(std::max(1u, std::thread::hardware_concurrency()));
+    return *pool;
+}
+
+// Below this many tiles handing them out costs more than it saves
+static const int MIN_PARALLEL_TILES = 16;
+
+// Runs fn(tile, scratch) for every tile, spreading tiles over the calling
+// thread and tilePool(). Each thread gets its own Scratch so buffers are
+// reused across tiles. The caller works through the tiles too, so a busy
+// pool only means fewer helpers: helpers that start after the caller has
+// finished find the call closed and return without touching it.
+template<class Scratch, class F>
+static void parallelForTiles(int tileCount, int threads, F&& fn) {
+    if (threads <= 0) {
+        threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    threads = std::min(threads, tileCount);
+    if (threads <= 1 || tileCount < MIN_PARALLEL_TILES) {
+        Scratch scratch;
+        for (int tile = 0; tile < tileCount; ++tile) {
+            fn(tile, scratch);
+        }
+        return;
+    }
+
+    struct Call {
+        std::atomic<int> next{0};
+        std::mutex mutex;
+        std::condition_variable idle;
+        int active = 0;
+        bool closed = false;
+    };
+    auto call = std::make_shared<Call>();
+    auto work = [&fn, tileCount](Call& state) {
+        Scratch scratch;
+        for (int tile = state.next++; tile < tileCount; tile = state.next++) {
+            fn(tile, scratch);
+        }
+    };
+    // Only dereferenced while the caller is waiting for active to drop
+    auto* workPtr = &work;
+
+    for (int i = 1; i < threads; ++i) {
+        tilePool().enqueue([call, workPtr]() {
+            {
+                std::lock_guard<std::mutex> lock(call->mutex);
+                if (call->closed) {
+                    return;
+                }
+                call->active++;
+            }
+            (*workPtr)(*call);
+            {
+                std::lock_guard<std::mutex> lock(call->mutex);
+                call->active--;
+            }
+            call->idle.notify_all();
+        });
+    }
+
+    work(*call);
+    std::unique_lock<std::mutex> lock(call->mutex);
+    call->closed = true;
+    call->idle.wait(lock, [&]() { return call->active == 0; });
+}
+
+// Unpacks pixs into one byte per pixel, which every adaptive method reads
+// many times over
+static bool extractGrayPlane(Pix* pixs, std::vector<l_uint8>& plane, int& width, int& height) {
+    Pix* source = nullptr;
+    l_int32 depth = pixGetDepth(pixs);
+    if (depth == 32 || (depth == 8 && !pixGetColormap(pixs))) {
+        source = pixClone(pixs);
+    } else {
+        source = pixConvertTo8(pixs, 0);
+        if (!source || pixGetColormap(source)) {
+            pixDestroy(&source);
+            return false;
+        }
+        depth = 8;
+    }
+
+    pixGetDimensions(source, &width, &height, nullptr);
+    plane.resize(static_cast<size_t>(width) * height);
+    l_uint32* data = pixGetData(source);
+    l_int32 wpl = pixGetWpl(source);
+
+    for (int y = 0; y < height; ++y) {
+        const l_uint32* line = data + y * wpl;
+        l_uint8* out = plane.data() + static_cast<size_t>(y) * width;
+        if (depth == 32) {
+            for (int x = 0; x < width; ++x) {
+                out[x] = static_cast<l_uint8>((weightedSum(line[x]) + 5) / 10);
+            }
+        } else {
+            for (int x = 0; x < width; ++x) {
+                out[x] = GET_DATA_BYTE(line, x);
+            }
+        }
+    }
+
+    pixDestroy(&source);
+    return true;
+}
+
+// Packs one row of 0/1 flags, starting at a word boundary, into 1 bpp words
+static void packRow(const l_uint8* dark, int count, l_uint32* dst) {
+    for (int w = 0; w * 32 < count; ++w) {
+        int n = std::min(32, count - w * 32);
+        l_uint32 bits = 0;
+        for (int k = 0; k < n; ++k) {
+            bits |= static_cast<l_uint32>(dark[w * 32 + k]) << (31 - k);
+        }
+        dst[w] = bits;
+    }
+}
+
+static int otsuThreshold(const l_uint32* histogram) {
+    l_uint64 total = 0;
+    double sumAll = 0.0;
+    for (int i = 0; i < 256; ++i) {
+        total += histogram[i];
+        sumAll += static_cast<double>(i) * histogram[i];
+    }
+    if (total == 0) {
+        return 128;
+    }
+
+    double sumBelow = 0.0;
+    l_uint64 countBelow = 0;
+    double bestVariance = -1.0;
+    int best = 128;
+    for (int t = 0; t < 256; ++t) {
+        countBelow += histogram[t];
+        if (countBelow == 0) {
+            continue;
+        }
+        l_uint64 countAbove = total - countBelow;
+        if (countAbove == 0) {
+            break;
+        }
+        sumBelow += static_cast<double>(t) * histogram[t];
+        double meanBelow = sumBelow / countBelow;
+        double meanAbove = (sumAll - sumBelow) / countAbove;
+        double variance = static_cast<double>(countBelow) * countAbove * (meanBelow - meanAbove) * (meanBelow - meanAbove);
+        if (variance > bestVariance) {
+            bestVariance = variance;
+            best = t;
+        }
+    }
+    // Pixels at or below the Otsu level are foreground
+    return best + 1;
+}
+
+struct NoScratch {};
+
+struct SauvolaScratch {
+    std::vector<l_uint32> sums;
+    std::vector<l_uint64> squares;
+    std::vector<l_uint8> dark;
+};
+
+static void otsuTiles(const std::vector<l_uint8>& plane, const TileGrid& grid, int threads, Pix* binary) {
+    // Pass 1: histogram and threshold of every tile
+    std::vector<l_uint32> histograms(static_cast<size_t>(grid.count()) * 256, 0);
+    parallelForTiles<NoScratch>(grid.count(), threads, [&](int tile, NoScratch&) {
+        l_uint32* histogram = histograms.data() + static_cast<size_t>(tile) * 256;
+        for (int y = grid.y0(tile); y < grid.y1(tile); ++y) {
+            const l_uint8* row = plane.data() + static_cast<size_t>(y) * grid.width;
+            for (int x = grid.x0(tile); x < grid.x1(tile); ++x) {
+                histogram[row[x]]++;
+            }
+        }
+    });
+
+    l_uint32 global[256] = {0};
+    for (int tile = 0; tile < grid.count(); ++tile) {
+        for (int i = 0; i < 256; ++i) {
+            global[i] += histograms[static_cast<size_t>(tile) * 256 + i];
+        }
+    }
+    int globalThreshold = otsuThreshold(global);
+
+    // Tiles without real contrast (blank paper, solid fills) would turn
+    // noise into ink, so they fall back to the page-wide threshold
+    std::vector<int> thresholds(grid.count());
+    for (int tile = 0; tile < grid.count(); ++tile) {
+        const l_uint32* histogram = histograms.data() + static_cast<size_t>(tile) * 256;
+        double count = 0.0, sum = 0.0, squares = 0.0;
+        for (int i = 0; i < 256; ++i) {
+            count += histogram[i];
+            sum += static_cast<double>(i) * histogram[i];
+            squares += static_cast<double>(i) * i * histogram[i];
+        }
+        double mean = sum / std::max(count, 1.0);
+        double deviation = std::sqrt(std::max(squares / std::max(count, 1.0) - mean * mean, 0.0));
+        thresholds[tile] = (deviation < 16.0) ? globalThreshold : otsuThreshold(histogram);
+    }
+
+    // Smooth over the 3x3 tile neighbourhood to hide tile seams
+    std::vector<int> smoothed(grid.count());
+    for (int ty = 0; ty < grid.tilesY; ++ty) {
+        for (int tx = 0; tx < grid.tilesX; ++tx) {
+            int sum = 0, count = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = tx + dx, ny = ty + dy;
+                    if (nx >= 0 && ny >= 0 && nx < grid.tilesX && ny < grid.tilesY) {
+                        sum += thresholds[ny * grid.tilesX + nx];
+                        count++;
+                    }
+                }
+            }
+            smoothed[ty * grid.tilesX + tx] = sum / count;
+        }
+    }
+
+    // Pass 2: apply each tile's threshold
+    l_uint32* dstData = pixGetData(binary);
+    l_int32 dstWpl = pixGetWpl(binary);
+    parallelForTiles<std::vector<l_uint8>>(grid.count(), threads, [&](int tile, std::vector<l_uint8>& dark) {
+        int x0 = grid.x0(tile), x1 = grid.x1(tile);
+        int threshold = smoothed[tile];
+        dark.resize(x1 - x0);
+        for (int y = grid.y0(tile); y < grid.y1(tile); ++y) {
+            const l_uint8* row = plane.data() + static_cast<size_t>(y) * grid.width + x0;
+            for (int x = 0; x < x1 - x0; ++x) {
+                dark[x] = row[x] < threshold;
+            }
+            packRow(dark.data(), x1 - x0, dstData + y * dstWpl + x0 / 32);
+        }
+    });
+}
+
+static void sauvolaTiles(const std::vector<l_uint8>& plane, const TileGrid& grid,
+                  const AdaptiveThresholdOptions& options, Pix* binary) {
+    const int r = std::max(1, options.windowRadius);
+    const float k = options.sauvolaK;
+    l_uint32* dstData = pixGetData(binary);
+    l_int32 dstWpl = pixGetWpl(binary);
+
+    parallelForTiles<SauvolaScratch>(grid.count(), options.threads, [&](int tile, SauvolaScratch& scratch) {
+        int x0 = grid.x0(tile), x1 = grid.x1(tile);
+        int y0 = grid.y0(tile), y1 = grid.y1(tile);
+
+        // Integral images over the tile plus a halo of r pixels
+        int hx0 = std::max(x0 - r, 0), hx1 = std::min(x1 + r, grid.width);
+        int hy0 = std::max(y0 - r, 0), hy1 = std::min(y1 + r, grid.height);
+        int stride = hx1 - hx0 + 1;
+        scratch.sums.assign(static_cast<size_t>(stride) * (hy1 - hy0 + 1), 0);
+        scratch.squares.assign(static_cast<size_t>(stride) * (hy1 - hy0 + 1), 0);
+
+        for (int y = hy0; y < hy1; ++y) {
+            const l_uint8* row = plane.data() + static_cast<size_t>(y) * grid.width;
+            const l_uint32* sumAbove = scratch.sums.data() + static_cast<size_t>(y - hy0) * stride;
+            const l_uint64* sqAbove = scratch.squares.data() + static_cast<size_t>(y - hy0) * stride;
+            l_uint32* sumRow = scratch.sums.data() + static_cast<size_t>(y - hy0 + 1) * stride;
+            l_uint64* sqRow = scratch.squares.data() + static_cast<size_t>(y - hy0 + 1) * stride;
+            l_uint32 runSum = 0;
+            l_uint64 runSq = 0;
+            for (int x = hx0; x < hx1; ++x) {
+                l_uint32 v = row[x];
+                runSum += v;
+                runSq += v * v;
+                sumRow[x - hx0 + 1] = sumAbove[x - hx0 + 1] + runSum;
+                sqRow[x - hx0 + 1] = sqAbove[x - hx0 + 1] + runSq;
+            }
+        }
+
+        scratch.dark.resize(x1 - x0);
+        for (int y = y0; y < y1; ++y) {
+            int ya = std::max(y - r, 0) - hy0;
+            int yb = std::min(y + r + 1, grid.height) - hy0;
+            const l_uint32* sumA = scratch.sums.data() + static_cast<size_t>(ya) * stride;
+            const l_uint32* sumB = scratch.sums.data() + static_cast<size_t>(yb) * stride;
+            const l_uint64* sqA = scratch.squares.data() + static_cast<size_t>(ya) * stride;
+            const l_uint64* sqB = scratch.squares.data() + static_cast<size_t>(yb) * stride;
+            const l_uint8* row = plane.data() + static_cast<size_t>(y) * grid.width;
+
+            // Window bounds only clamp near the image edges; the interior
+            // loop uses fixed offsets so the compiler can vectorize it
+            auto classify = [&](int x, int xa, int xb) {
+                l_int64 n = static_cast<l_int64>(xb - xa) * (yb - ya);
+                l_int64 sum = static_cast<l_int64>(sumB[xb] - sumA[xb] - sumB[xa] + sumA[xa]);
+                l_int64 sq = static_cast<l_int64>(sqB[xb] - sqA[xb] - sqB[xa] + sqA[xa]);
+                float mean = static_cast<float>(sum) / n;
+                float variance = static_cast<float>(n * sq - sum * sum) / static_cast<float>(n * n);
+                float threshold = mean * (1.0f + k * (std::sqrt(variance) / 128.0f - 1.0f));
+                return static_cast<l_uint8>(row[x] < threshold);
+            };
+
+            int interiorStart = std::clamp(r, x0, x1);
+            int interiorEnd = std::clamp(grid.width - r - 1, interiorStart, x1);
+            for (int x = x0; x < interiorStart; ++x) {
+                scratch.dark[x - x0] = classify(x, std::max(x - r, 0) - hx0, std::min(x + r + 1, grid.width) - hx0);
+            }
+            for (int x = interiorStart; x < interiorEnd; ++x) {
+                scratch.dark[x - x0] = classify(x, x - r - hx0, x + r + 1 - hx0);
+            }
+            for (int x = interiorEnd; x < x1; ++x) {
+                scratch.dark[x - x0] = classify(x, std::max(x - r, 0) - hx0, std::min(x + r + 1, grid.width) - hx0);
+            }
+
+            packRow(scratch.dark.data(), x1 - x0, dstData + y * dstWpl + x0 / 32);
+        }
+    });
+}
+
+Pix* binarizeAdaptive(Pix* pixs, BinarizationMode mode, const AdaptiveThresholdOptions& options) {
+    if (!pixs) {
+        return nullptr;
+    }
+    if (mode != BinarizationMode::Otsu && mode != BinarizationMode::Sauvola) {
+        return binarizeGlobal(pixs, 128);
+    }
+
+    std::vector<l_uint8> plane;
+    int width = 0, height = 0;
+    if (!extractGrayPlane(pixs, plane, width, height)) {
+        return nullptr;
+    }
+
+    Pix* binary = pixCreateNoInit(width, height, 1);
+    if (!binary) {
+        return nullptr;
+    }
+    pixCopyResolution(binary, pixs);
+
+    TileGrid grid;
+    grid.width = width;
+    grid.height = height;
+    grid.tileSize = std::max(32, (options.tileSize + 31) / 32 * 32);
+    grid.tilesX = (width + grid.tileSize - 1) / grid.tileSize;
+    grid.tilesY = (height + grid.tileSize - 1) / grid.tileSize;
+
+    if (mode == BinarizationMode::Otsu) {
+        otsuTiles(plane, grid, options.threads, binary);
+    } else {
+        sauvolaTiles(plane, grid, options, binary);
+    }
+
+    return binary;
+}
+
+// ===== Text height estimation =====
+
+int estimateTextHeight(Pix* pixs) {
+    if (!pixs) {
+        return 0;
+    }
+
+    // Components only have to be measured, so a sampled copy with the long
+    // side around 1600 px is plenty and keeps this to a few milliseconds
+    const int SAMPLE_LONG_SIDE = 1600;
+    const int MIN_COMPONENTS = 20;
+
+    l_int32 width, height;
+    pixGetDimensions(pixs, &width, &height, nullptr);
+    float scale = std::min(1.0f, static_cast<float>(SAMPLE_LONG_SIDE) / std::max(width, height));
+
+    Pix* sample = (scale < 1.0f) ? pixScaleBySampling(pixs, scale, scale) : pixClone(pixs);
+    if (!sample) {
+        return 0;
+    }
+
+    Pix* binary = nullptr;
+    if (pixGetDepth(sample) == 1) {
+        binary = pixClone(sample);
+    } else {
+        AdaptiveThresholdOptions options;
+        options.threads = 1;
+        binary = binarizeAdaptive(sample, BinarizationMode::Otsu, options);
+    }
+    l_int32 sampleHeight = pixGetHeight(sample);
+    pixDestroy(&sample);
+    if (!binary) {
+        return 0;
+    }
+
+    BOXA* boxes = pixConnCompBB(binary, 8);
+    pixDestroy(&binary);
+    if (!boxes) {
+        return 0;
+    }
+
+    // Keep character-sized components: not specks, not rules or photos
+    std::vector<int> heights;
+    l_int32 count = boxaGetCount(boxes);
+    for (l_int32 i = 0; i < count; ++i) {
+        l_int32 x, y, w, h;
+        boxaGetBoxGeometry(boxes, i, &x, &y, &w, &h);
+        if (h >= 3 && h <= sampleHeight / 4 && w <= 3 * h) {
+            heights.push_back(h);
+        }
+    }
+    boxaDestroy(&boxes);
+
+    if (static_cast<int>(heights.size()) < MIN_COMPONENTS) {
+        return 0;
+    }
+
+    std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+    return static_cast<int>(heights[heights.size() / 2] / scale + 0.5f);
+}
+
+// ===== Blank page detection =====
+
+static void countMarksScalar(const l_uint8* row, int width, int background, int contrast,
+                             long long& ink, long long& edges) {
+    for (int x = 0; x < width; ++x) {
+        if (std::abs(row[x] - background) >= contrast) {
+            ink++;
+        }
+        if (x + 1 < width && std::abs(row[x + 1] - row[x]) >= contrast) {
+            edges++;
+        }
+    }
+}
+
+#ifdef OCR_KERNELS_X86
+
+static inline __m128i absDiffU8(__m128i a, __m128i b) {
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+static void countMarksSse2(const l_uint8* row, int width, int background, int contrast,
+                           long long& ink, long long& edges) {
+    // d >= contrast  <=>  d - (contrast - 1), saturating, is non-zero
+    const __m128i backgroundBytes = _mm_set1_epi8(static_cast<char>(background));
+    const __m128i belowContrast = _mm_set1_epi8(static_cast<char>(contrast - 1));
+    const __m128i zero = _mm_setzero_si128();
+
+    // The neighbour load reads one byte ahead, so stop a byte early
+    int x = 0;
+    for (; x + 16 < width; x += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1));
+        __m128i plain = _mm_cmpeq_epi8(_mm_subs_epu8(absDiffU8(pixels, backgroundBytes), belowContrast), zero);
+        __m128i flat = _mm_cmpeq_epi8(_mm_subs_epu8(absDiffU8(pixels, next), belowContrast), zero);
+        ink += 16 - std::popcount(static_cast<unsigned>(_mm_movemask_epi8(plain)));
+        edges += 16 - std::popcount(static_cast<unsigned>(_mm_movemask_epi8(flat)));
+    }
+    countMarksScalar(row + x, width - x, background, contrast, ink, edges);
+}
+
+#endif // OCR_KERNELS_X86
+
+// Ink and edge fractions of a gray plane, against its median gray level
+static InkStatistics measurePlane(const std::vector<l_uint8>& plane, int width, int height, int contrast) {
+    InkStatistics stats;
+    l_uint32 histogram[256] = {};
+    for (l_uint8 value : plane) {
+        histogram[value]++;
+    }
+    int background = 0;
+    for (size_t below = 0; below + histogram[background] <= plane.size() / 2; ++background) {
+        below += histogram[background];
+    }
+
+    long long ink = 0;
+    long long edges = 0;
+    for (int y = 0; y < height; ++y) {
+        const l_uint8* row = plane.data() + static_cast<size_t>(y) * width;
+#ifdef OCR_KERNELS_X86
+        countMarksSse2(row, width, background, contrast, ink, edges);
+#else
+        countMarksScalar(row, width, background, contrast, ink, edges);
+#endif
+    }
+
+    stats.inkFraction = static_cast<float>(ink) / plane.size();
+    if (width > 1) {
+        stats.edgeFraction = static_cast<float>(edges) / (static_cast<long long>(width - 1) * height);
+    }
+    return stats;
+}
+
+bool measureInk(Pix* pixs, int contrast, InkStatistics& stats) {
+    const long long FULL_RESOLUTION_PIXELS = 2000000;
+    const int REDUCED_LONG_SIDE = 512;
+
+    stats = InkStatistics();
+    if (!pixs || contrast < 1 || contrast > 255) {
+        return false;
+    }
+
+    std::vector<l_uint8> plane;
+    int width = 0;
+    int height = 0;
+    l_int32 pixsWidth, pixsHeight;
+    pixGetDimensions(pixs, &pixsWidth, &pixsHeight, nullptr);
+    if (static_cast<long long>(pixsWidth) * pixsHeight <= FULL_RESOLUTION_PIXELS) {
+        if (!extractGrayPlane(pixs, plane, width, height) || plane.empty()) {
+            return false;
+        }
+        stats = measurePlane(plane, width, height, contrast);
+        return true;
+    }
+
+    // Each reduced pixel keeps the darkest, then the lightest, pixel of its
+    // block, so a stroke one pixel wide still reaches the reduced copy at
+    // full contrast, whichever way round text and background are
+    Pix* gray = (pixGetDepth(pixs) == 8 && !pixGetColormap(pixs)) ? pixClone(pixs) : pixConvertTo8(pixs, 0);
+    if (!gray || pixGetColormap(gray)) {
+        pixDestroy(&gray);
+        return false;
+    }
+    int factor = (std::max(pixsWidth, pixsHeight) + REDUCED_LONG_SIDE - 1) / REDUCED_LONG_SIDE;
+    bool measured = false;
+    for (l_int32 type : {L_CHOOSE_MIN, L_CHOOSE_MAX}) {
+        Pix* reduced = pixScaleGrayMinMax(gray, factor, factor, type);
+        bool extracted = reduced && extractGrayPlane(reduced, plane, width, height) && !plane.empty();
+        pixDestroy(&reduced);
+        if (extracted) {
+            InkStatistics extreme = measurePlane(plane, width, height, contrast);
+            stats.inkFraction = std::max(stats.inkFraction, extreme.inkFraction);
+            stats.edgeFraction = std::max(stats.edgeFraction, extreme.edgeFraction);
+            measured = true;
+        }
+    }
+    pixDestroy(&gray);
+    return measured;
+}
+
+// ===== Orientation and skew =====
+
+// Squared coefficient of variation of a projection profile. Rows across
+// horizontal text alternate between ink and inter-line gaps, so their
+// profile varies far more than the columns cutting across many lines.
+static double profileContrast(const std::vector<l_int32>& profile) {
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (l_int32 value : profile) {
+        sum += value;
+        sumSquares += static_cast<double>(value) * value;
+    }
+    if (profile.empty() || sum <= 0.0) {
+        return 0.0;
+    }
+    double mean = sum / profile.size();
+    return (sumSquares / profile.size() - mean * mean) / (mean * mean);
+}
+
+static void projectionProfiles(Pix* pix, std::vector<l_int32>& rows, std::vector<l_int32>& columns) {
+    l_int32 width = pixGetWidth(pix);
+    l_int32 height = pixGetHeight(pix);
+    l_int32 wpl = pixGetWpl(pix);
+    const l_uint32* data = pixGetData(pix);
+
+    rows.assign(height, 0);
+    columns.assign(width, 0);
+    for (l_int32 y = 0; y < height; ++y) {
+        const l_uint32* line = data + y * wpl;
+        for (l_int32 w = 0; w < wpl; ++w) {
+            l_uint32 word = line[w];
+            rows[y] += std::popcount(word);
+            while (word) {
+                int bit = std::countl_zero(word);
+                l_int32 x = w * 32 + bit;
+                if (x < width) {
+                    columns[x]++;
+                }
+                word &= ~(0x80000000u >> bit);
+            }
+        }
+    }
+}
+
+Pix* normalizeOrientation(Pix* pixs, OrientationEstimate& estimate) {
+    // Leptonica's own thresholds for a trustworthy up/down decision and skew
+    const float MIN_UPDOWN_CONFIDENCE = 8.0f;
+    const float MIN_SKEW_CONFIDENCE = 3.0f;
+    const float MIN_SKEW_DEGREES = 0.1f;
+    // How much spikier one profile must be than the other
+    const double MIN_PROFILE_RATIO = 2.5;
+    const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+
+    estimate = OrientationEstimate();
+    if (!pixs || pixGetDepth(pixs) != 1) {
+        return nullptr;
+    }
+
+    // 4x reduction merges letters into word blobs, which smooths the
+    // column profile of horizontal text without blurring the line gaps
+    Pix* reduced = pixReduceRankBinaryCascade(pixs, 1, 1, 0, 0);
+    if (!reduced) {
+        return nullptr;
+    }
+    std::vector<l_int32> rows, columns;
+    projectionProfiles(reduced, rows, columns);
+    pixDestroy(&reduced);
+
+    double rowContrast = profileContrast(rows);
+    double columnContrast = profileContrast(columns);
+    bool horizontal;
+    if (rowContrast >= columnContrast * MIN_PROFILE_RATIO) {
+        horizontal = true;
+    } else if (columnContrast >= rowContrast * MIN_PROFILE_RATIO) {
+        horizontal = false;
+    } else {
+        return nullptr;
+    }
+
+    Pix* oriented = horizontal ? pixClone(pixs) : pixRotateOrth(pixs, 1);
+    if (!oriented) {
+        return nullptr;
+    }
+
+    // Positive confidence means more ascenders than descenders, i.e. upright
+    l_float32 upConfidence = 0.0f;
+    if (pixUpDownDetect(oriented, &upConfidence, 0, 0, 0) != 0 ||
+        std::fabs(upConfidence) < MIN_UPDOWN_CONFIDENCE) {
+        pixDestroy(&oriented);
+        return nullptr;
+    }
+    int rotation = horizontal ? 0 : 90;
+    if (upConfidence < 0.0f) {
+        Pix* flipped = pixRotateOrth(oriented, 2);
+        pixDestroy(&oriented);
+        if (!flipped) {
+            return nullptr;
+        }
+        oriented = flipped;
+        rotation += 180;
+    }
+
+    l_float32 skew = 0.0f;
+    l_float32 skewConfidence = 0.0f;
+    if (pixFindSkew(oriented, &skew, &skewConfidence) == 0 &&
+        skewConfidence >= MIN_SKEW_CONFIDENCE && std::fabs(skew) >= MIN_SKEW_DEGREES) {
+        Pix* deskewed = pixRotate(oriented, static_cast<l_float32>(skew * DEGREES_TO_RADIANS),
+                                  L_ROTATE_SAMPLING, L_BRING_IN_WHITE, 0, 0);
+        if (deskewed) {
+            pixDestroy(&oriented);
+            oriented = deskewed;
+            estimate.skewDegrees = skew;
+        }
+    }
+
+    estimate.rotation = rotation;
+    estimate.certain = true;
+    return oriented;
+}
+
+// ===== Text region detection =====
+
+struct TextLine {
+    l_int32 x, y, w, h;
+};
+
+// Whether lines, inside [left, right) x [top, bottom), form a single block.
+// Counting lines per column, a gutter is a dip to under a quarter of the
+// count on both sides, at least a text height wide; a heading across
+// columns doesn't hide it. Rows without lines are the gaps between them,
+// and a gap well beyond the usual spacing separates stacked blocks.
+static bool isSingleBlock(const std::vector<TextLine>& lines, l_int32 left, l_int32 top, l_int32 right, l_int32 bottom,
+                          int lineHeight) {
+    std::vector<int> columns(right - left, 0);
+    std::vector<bool> rows(bottom - top, false);
+    for (const TextLine& line : lines) {
+        for (l_int32 x = line.x; x < line.x + line.w; ++x) {
+            ++columns[x - left];
+        }
+        std::fill(rows.begin() + (line.y - top), rows.begin() + (line.y + line.h - top), true);
+    }
+
+    std::vector<int> rightMost(columns.size() + 1, 0);
+    for (size_t x = columns.size(); x-- > 0;) {
+        rightMost[x] = std::max(rightMost[x + 1], columns[x]);
+    }
+    int leftMost = 0;
+    int dip = 0;
+    for (size_t x = 0; x < columns.size(); ++x) {
+        leftMost = std::max(leftMost, columns[x]);
+        dip = (columns[x] * 4 < std::min(leftMost, rightMost[x + 1])) ? dip + 1 : 0;
+        if (dip >= lineHeight) {
+            return false;
+        }
+    }
+
+    std::vector<int> gaps;
+    int gap = 0;
+    for (bool covered : rows) {
+        if (!covered) {
+            ++gap;
+        } else if (gap > 0) {
+            gaps.push_back(gap);    // The first row is covered, so no leading margin
+            gap = 0;
+        }
+    }
+    if (gaps.empty()) {
+        return true;
+    }
+    int widest = *std::max_element(gaps.begin(), gaps.end());
+    std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+    int usual = (gaps.size() >= 3) ? gaps[gaps.size() / 2] : 0;
+    return widest <= std::max(3 * usual, 3 * lineHeight);
+}
+
+bool findTextBounds(Pix* pixs, int textHeight, TextBounds& bounds) {
+    const int REDUCTION = 4;
+
+    bounds = TextBounds();
+    if (!pixs || pixGetDepth(pixs) != 1 || textHeight <= 0) {
+        return false;
+    }
+
+    Pix* reduced = pixReduceRankBinaryCascade(pixs, 1, 1, 0, 0);
+    if (!reduced) {
+        return false;
+    }
+
+    // Closing across word gaps, roughly one text height, turns each line
+    // into a single wide component
+    int lineHeight = std::max(2, textHeight / REDUCTION);
+    Pix* lines = pixCloseBrick(nullptr, reduced, std::max(3, lineHeight + 1), 1);
+    pixDestroy(&reduced);
+    if (!lines) {
+        return false;
+    }
+
+    BOXA* boxes = pixConnCompBB(lines, 8);
+    pixDestroy(&lines);
+    if (!boxes) {
+        return false;
+    }
+
+    std::vector<TextLine> kept;
+    l_int32 count = boxaGetCount(boxes);
+    for (l_int32 i = 0; i < count; ++i) {
+        TextLine line;
+        boxaGetBoxGeometry(boxes, i, &line.x, &line.y, &line.w, &line.h);
+        // A line is a bit taller than its x-height and at least a short
+        // word wide; allow two touching lines merged by the closing
+        if (line.h * 2 >= lineHeight && line.h <= lineHeight * 3 && line.w >= line.h * 2) {
+            kept.push_back(line);
+        }
+    }
+    boxaDestroy(&boxes);
+
+    if (kept.empty()) {
+        return false;
+    }
+
+    l_int32 left = kept[0].x, top = kept[0].y;
+    l_int32 right = kept[0].x + kept[0].w, bottom = kept[0].y + kept[0].h;
+    for (const TextLine& line : kept) {
+        left = std::min(left, line.x);
+        top = std::min(top, line.y);
+        right = std::max(right, line.x + line.w);
+        bottom = std::max(bottom, line.y + line.h);
+    }
+
+    l_int32 width, height;
+    pixGetDimensions(pixs, &width, &height, nullptr);
+    int margin = 2 * textHeight;
+    bounds.x = std::max(0, left * REDUCTION - margin);
+    bounds.y = std::max(0, top * REDUCTION - margin);
+    bounds.width = std::min(width, right * REDUCTION + margin) - bounds.x;
+    bounds.height = std::min(height, bottom * REDUCTION + margin) - bounds.y;
+    bounds.lines = static_cast<int>(kept.size());
+    bounds.singleColumn = isSingleBlock(kept, left, top, right, bottom, lineHeight);
+    return bounds.width > 0 && bounds.height > 0;
+}
+
+BinarizationMode parseBinarizationMode(const std::string& name) {
+    if (name == "global") return BinarizationMode::Global;
+    if (name == "otsu") return BinarizationMode::Otsu;
+    if (name == "sauvola") return BinarizationMode::Sauvola;
+    return BinarizationMode::Default;
+}
+
+const char* binarizationModeName(BinarizationMode mode) {
+    switch (mode) {
+        case BinarizationMode::Global: return "global";
+        case BinarizationMode::Otsu: return "otsu";
+        case BinarizationMode::Sauvola: return "sauvola";
+        default: return "default";
+    }
+}
\ No newline at end of file
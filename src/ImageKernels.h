@@ -0,0 +1,89 @@
+#ifndef IMAGEKERNELS_H
+#define IMAGEKERNELS_H
+
+#include <leptonica/allheaders.h>
+#include <string>
+
+// Converts pixs to grayscale and thresholds it in a single pass, writing
+// straight into a new 1 bpp Pix. Pixels darker than threshold become
+// foreground, bit for bit like pixConvertTo8 + pixThresholdToBinary (the
+// luminance weights are Leptonica's, in exact integer form) but without the
+// intermediate 8 bpp image. 32 bpp RGB and plain 8 bpp gray take the
+// vectorized path; other depths are converted with pixConvertTo8 first.
+// Returns nullptr on failure; the caller keeps ownership of pixs.
+Pix* binarizeGlobal(Pix* pixs, int threshold);
+
+// Row kernel selected for this CPU: "avx2", "sse2" or "scalar"
+const char* binarizeKernelName();
+
+enum class BinarizationMode {
+    Default,    // Whatever the server is configured with
+    Global,     // Fixed threshold (binarizeGlobal)
+    Otsu,       // Per-tile Otsu threshold
+    Sauvola     // Local mean/deviation over a sliding window
+};
+
+struct AdaptiveThresholdOptions {
+    int tileSize = 256;         // Rounded up to a multiple of 32
+    int windowRadius = 15;      // Sauvola window is (2r+1) x (2r+1)
+    float sauvolaK = 0.34f;
+    int threads = 0;            // 0 = one per core, capped by tile count
+};
+
+// Binarizes pixs with a locally varying threshold, which copes with uneven
+// lighting where a fixed threshold fails. The image is split into tiles
+// that are processed in parallel; Sauvola statistics come from per-tile
+// integral images that include a halo of windowRadius pixels.
+Pix* binarizeAdaptive(Pix* pixs, BinarizationMode mode,
+                      const AdaptiveThresholdOptions& options = AdaptiveThresholdOptions());
+
+// Estimates the typical text height of pixs in pixels from the median
+// connected-component height of a downsampled, binarized copy. Returns 0
+// when the image doesn't contain enough character-like components.
+int estimateTextHeight(Pix* pixs);
+
+struct InkStatistics {
+    float inkFraction = 0.0f;   // Pixels at least contrast away from the background gray
+    float edgeFraction = 0.0f;  // Horizontally neighbouring pairs at least contrast apart
+};
+
+// Measures how much of pixs is marked. Images up to 2 MP are measured at
+// full resolution; larger ones on min- and max-reduced copies with the
+// long side around 512 px, which keep thin strokes at full contrast where
+// sampling would skip them. The background is the median gray level, so
+// light text on a dark page counts as ink too. Rows are scanned 16 pixels
+// at a time. Returns false if pixs can't be converted to gray.
+bool measureInk(Pix* pixs, int contrast, InkStatistics& stats);
+
+struct OrientationEstimate {
+    int rotation = 0;           // Clockwise degrees applied to make text upright: 0, 90, 180 or 270
+    float skewDegrees = 0.0f;   // Residual skew that was removed
+    bool certain = false;       // False when the caller should fall back to OSD
+};
+
+// Cheap orientation and skew correction for a 1 bpp page. Text lines are
+// found from the row/column projection profiles of a reduced copy,
+// up/down from ascender/descender counts and skew from a projection
+// profile sweep. Returns an upright, deskewed copy when the orientation is
+// unambiguous; otherwise returns nullptr and leaves estimate.certain false.
+Pix* normalizeOrientation(Pix* pixs, OrientationEstimate& estimate);
+
+struct TextBounds {
+    int x = 0, y = 0, width = 0, height = 0;
+    int lines = 0;              // Text lines inside the bounds
+    bool singleColumn = false;  // One block: no gutter, lines evenly spaced
+};
+
+// Finds the area of a 1 bpp page that holds text. Characters are merged
+// into lines by a horizontal closing on a 4x reduced copy; components with
+// a text line's height (judged against textHeight, the expected character
+// height in pixs) and shape are kept and their union, padded by a couple of
+// text heights, is returned. The lines are one column when their column
+// projection has no gutter and the gaps in their row projection are about
+// the same. Returns false when nothing looks like text.
+bool findTextBounds(Pix* pixs, int textHeight, TextBounds& bounds);
+
+BinarizationMode parseBinarizationMode(const std::string& name);
+const char* binarizationModeName(BinarizationMode mode);
+
+#endif // IMAGEKERNELS_H
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "Lexicon.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char LEXICON_MAGIC[8] = {'O', 'C', 'R', 'L', 'E', 'X', '1', '\0'};
+
+struct LexiconHeader {
+    char magic[8];
+    uint32_t wordCount;
+    uint32_t bucketCount;
+    uint32_t slotCount;
+    uint32_t poolBytes;
+    uint32_t reserved[2];
+};
+
+static unsigned char lower(char c) {
+    return static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+// FNV-1a over the lowercased word, seeded and then mixed so that nearby
+// seeds give unrelated slots
+static uint64_t hashWord(std::string_view word, uint32_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (char c : word) {
+        hash ^= lower(c);
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+Lexicon::~Lexicon() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+#else
+    if (m_data) {
+        munmap(const_cast<unsigned char*>(m_data), m_dataSize);
+    }
+#endif
+}
+
+std::unique_ptr<Lexicon> Lexicon::open(const std::string& path) {
+    std::unique_ptr<Lexicon> lexicon(new Lexicon());
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Cannot open lexicon " << path << std::endl;
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(LexiconHeader))) {
+        lexicon->m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (lexicon->m_mapping) {
+            lexicon->m_data = static_cast<const unsigned char*>(
+                MapViewOfFile(lexicon->m_mapping, FILE_MAP_READ, 0, 0, 0));
+            lexicon->m_dataSize = static_cast<size_t>(fileSize.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Cannot open lexicon " << path << std::endl;
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(LexiconHeader))) {
+        void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+        if (data != MAP_FAILED) {
+            lexicon->m_data = static_cast<const unsigned char*>(data);
+            lexicon->m_dataSize = static_cast<size_t>(status.st_size);
+        }
+    }
+    ::close(file);
+#endif
+
+    if (!lexicon->m_data) {
+        std::cerr << "Cannot map lexicon " << path << std::endl;
+        return nullptr;
+    }
+
+    LexiconHeader header;
+    std::memcpy(&header, lexicon->m_data, sizeof(header));
+    size_t expected = sizeof(header) + (static_cast<size_t>(header.bucketCount) + header.slotCount) * sizeof(uint32_t)
+                    + header.poolBytes;
+    if (std::memcmp(header.magic, LEXICON_MAGIC, sizeof(LEXICON_MAGIC)) != 0 ||
+        header.bucketCount == 0 || header.slotCount == 0 || expected != lexicon->m_dataSize) {
+        std::cerr << "Not a valid lexicon file: " << path << std::endl;
+        return nullptr;
+    }
+
+    lexicon->m_wordCount = header.wordCount;
+    lexicon->m_bucketCount = header.bucketCount;
+    lexicon->m_slotCount = header.slotCount;
+    lexicon->m_seeds = reinterpret_cast<const uint32_t*>(lexicon->m_data + sizeof(header));
+    lexicon->m_slots = lexicon->m_seeds + header.bucketCount;
+    lexicon->m_pool = reinterpret_cast<const unsigned char*>(lexicon->m_slots + header.slotCount);
+    return lexicon;
+}
+
+bool Lexicon::contains(std::string_view word) const {
+    if (word.empty() || word.size() > MAX_WORD_LENGTH) {
+        return false;
+    }
+    uint32_t seed = m_seeds[hashWord(word, 0) % m_bucketCount];
+    uint32_t offset = m_slots[hashWord(word, seed) % m_slotCount];
+    if (offset == 0) {
+        return false;
+    }
+
+    // The hash is only perfect for stored words, so anything else lands on
+    // some other word's slot
+    const unsigned char* entry = m_pool + offset - 1;
+    if (entry[0] != word.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (entry[1 + i] != lower(word[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Lexicon::build(std::vector<std::string> words, const std::string& path) {
+    for (std::string& word : words) {
+        std::transform(word.begin(), word.end(), word.begin(), [](char c) { return static_cast<char>(lower(c)); });
+    }
+    words.erase(std::remove_if(words.begin(), words.end(), [](const std::string& word) {
+        return word.empty() || word.size() > MAX_WORD_LENGTH;
+    }), words.end());
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty()) {
+        std::cerr << "No words for lexicon " << path << std::endl;
+        return false;
+    }
+
+    // Hash and displace: spread the words over small buckets, then place
+    // the fullest buckets first, trying seeds until all of a bucket's words
+    // land on free slots. A 0.8 load factor keeps the search short.
+    uint32_t wordCount = static_cast<uint32_t>(words.size());
+    uint32_t bucketCount = std::max<uint32_t>(1, wordCount / 4);
+    uint32_t slotCount = wordCount + wordCount / 4 + 1;
+
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        buckets[hashWord(words[i], 0) % bucketCount].push_back(i);
+    }
+    std::vector<uint32_t> order(bucketCount);
+    for (uint32_t i = 0; i < bucketCount; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    const uint32_t MAX_SEED = 1u << 24;
+    std::vector<uint32_t> seeds(bucketCount, 0);
+    std::vector<int64_t> slotWord(slotCount, -1);
+    std::vector<uint32_t> placed;
+    for (uint32_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        uint32_t seed = 1;
+        for (; seed < MAX_SEED; ++seed) {
+            placed.clear();
+            bool fits = true;
+            for (uint32_t word : buckets[bucket]) {
+                uint32_t slot = static_cast<uint32_t>(hashWord(words[word], seed) % slotCount);
+                if (slotWord[slot] != -1 || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                    fits = false;
+                    break;
+                }
+                placed.push_back(slot);
+            }
+            if (fits) {
+                break;
+            }
+        }
+        if (seed == MAX_SEED) {
+            std::cerr << "Failed to build a perfect hash for lexicon " << path << std::endl;
+            return false;
+        }
+        seeds[bucket] = seed;
+        for (size_t i = 0; i < placed.size(); ++i) {
+            slotWord[placed[i]] = buckets[bucket][i];
+        }
+    }
+
+    std::vector<unsigned char> pool;
+    std::vector<uint32_t> wordOffsets(wordCount);
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        wordOffsets[i] = static_cast<uint32_t>(pool.size());
+        pool.push_back(static_cast<unsigned char>(words[i].size()));
+        pool.insert(pool.end(), words[i].begin(), words[i].end());
+    }
+    std::vector<uint32_t> slots(slotCount, 0);
+    for (uint32_t slot = 0; slot < slotCount; ++slot) {
+        if (slotWord[slot] != -1) {
+            slots[slot] = wordOffsets[slotWord[slot]] + 1;
+        }
+    }
+
+    LexiconHeader header = {};
+    std::memcpy(header.magic, LEXICON_MAGIC, sizeof(LEXICON_MAGIC));
+    header.wordCount = wordCount;
+    header.bucketCount = bucketCount;
+    header.slotCount = slotCount;
+    header.poolBytes = static_cast<uint32_t>(pool.size());
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(seeds.data()), seeds.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char*>(pool.data()), pool.size());
+    if (!file) {
+        std::cerr << "Failed to write lexicon " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Lexicon::buildFromWordList(const std::string& wordListPath, const std::string& path) {
+    std::ifstream list(wordListPath);
+    if (!list) {
+        std::cerr << "Cannot open word list " << wordListPath << std::endl;
+        return false;
+    }
+    std::vector<std::string> words;
+    std::string line;
+    while (std::getline(list, line)) {
+        size_t end = line.find_last_not_of(" \t\r");
+        if (end != std::string::npos) {
+            words.push_back(line.substr(0, end + 1));
+        }
+    }
+    return build(std::move(words), path);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only word list for post-recognition correction. The file is
+// memory-mapped as-is and searched through a perfect hash built with
+// hash-and-displace, so a lookup is two hashes, one probe and one string
+// compare, and opening a lexicon of any size costs no parsing. Several
+// processes serving the same file share its pages.
+//
+// Words are stored lowercase and matched case-insensitively (ASCII only).
+class Lexicon {
+public:
+    static const size_t MAX_WORD_LENGTH = 64;
+
+    ~Lexicon();
+
+    // nullptr if the file is missing or not a lexicon built by build()
+    static std::unique_ptr<Lexicon> open(const std::string& path);
+
+    // Writes a lexicon file for words; duplicates and words longer than
+    // MAX_WORD_LENGTH are dropped
+    static bool build(std::vector<std::string> words, const std::string& path);
+    // The same from a text file with one word per line, such as the output
+    // of Tesseract's dawg2wordlist
+    static bool buildFromWordList(const std::string& wordListPath, const std::string& path);
+
+    bool contains(std::string_view word) const;
+    size_t size() const { return m_wordCount; }
+
+private:
+    Lexicon() = default;
+
+    const unsigned char* m_data = nullptr;
+    size_t m_dataSize = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+
+    uint32_t m_wordCount = 0;
+    uint32_t m_bucketCount = 0;
+    uint32_t m_slotCount = 0;
+    const uint32_t* m_seeds = nullptr;      // Per bucket, picks the slot hash
+    const uint32_t* m_slots = nullptr;      // Offset into m_pool + 1, 0 = empty
+    const unsigned char* m_pool = nullptr;  // Length byte followed by the word
+};
+
+#endif // LEXICON_H
\ No newline at end of file
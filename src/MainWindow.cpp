@@ -25,6 +25,13 @@ ImageResultWidget::ImageResultWidget(const QString& filename, QWidget* parent)
     m_statusLabel = new QLabel("Processing...", this);
     m_statusLabel->setStyleSheet("color: orange; font-style: italic;");
 
+    // Only shown once the server reports progress on a slow image
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setMaximumHeight(12);
+    m_progressBar->setTextVisible(false);
+    m_progressBar->hide();
+
     m_textLabel = new QLabel("", this);
     m_textLabel->setWordWrap(true);
     m_textLabel->setAlignment(Qt::AlignTop | Qt::AlignLeft);
@@ -34,11 +41,13 @@ ImageResultWidget::ImageResultWidget(const QString& filename, QWidget* parent)
 
     layout->addWidget(m_filenameLabel);
     layout->addWidget(m_statusLabel);
+    layout->addWidget(m_progressBar);
     layout->addWidget(m_textLabel);
     layout->addStretch();
 }
 
 void ImageResultWidget::setResult(const QString& text, bool success, const QString& errorMessage) {
+    m_progressBar->hide();
     if (success) {
         m_statusLabel->setText("✓ Completed");
         m_statusLabel->setStyleSheet("color: green; font-weight: bold;");
@@ -55,6 +64,13 @@ void ImageResultWidget::setResult(const QString& text, bool success, const QStri
 void ImageResultWidget::setPending() {
     m_statusLabel->setText("Processing...");
     m_statusLabel->setStyleSheet("color: orange; font-style: italic;");
+    m_progressBar->hide();
+}
+
+void ImageResultWidget::setProgress(const QString& stage, int percent) {
+    m_statusLabel->setText(percent > 0 ? QString("%1... %2%").arg(stage).arg(percent) : stage + "...");
+    m_progressBar->setValue(percent);
+    m_progressBar->show();
 }
 
 // ===== MainWindow Implementation =====
@@ -169,6 +185,8 @@ void MainWindow::onConnectClicked() {
 
         connect(m_ocrClient.get(), &OCRClient::resultReceived,
             this, &MainWindow::onResultReceived);
+        connect(m_ocrClient.get(), &OCRClient::progressReceived,
+            this, &MainWindow::onProgressReceived);
         connect(m_ocrClient.get(), &OCRClient::connectionStatusChanged,
             this, &MainWindow::onConnectionStatusChanged);
         connect(m_ocrClient.get(), &OCRClient::connectionError,
@@ -252,6 +270,13 @@ void MainWindow::onResultReceived(QString imageId, QString extractedText, bool s
     }
 }
 
+void MainWindow::onProgressReceived(QString imageId, QString stage, int percent) {
+    auto it = m_imageWidgets.find(imageId);
+    if (it != m_imageWidgets.end()) {
+        it.value()->setProgress(stage, percent);
+    }
+}
+
 void MainWindow::onConnectionStatusChanged(bool connected) {
     if (connected) {
         m_statusLabel->setText("✓ Connected to server");
@@ -21,10 +21,12 @@ public:
     explicit ImageResultWidget(const QString& filename, QWidget* parent = nullptr);
     void setResult(const QString& text, bool success, const QString& errorMessage);
     void setPending();
+    void setProgress(const QString& stage, int percent);
 
 private:
     QLabel* m_filenameLabel;
     QLabel* m_statusLabel;
+    QProgressBar* m_progressBar;
     QLabel* m_textLabel;
 };
 
@@ -39,6 +41,7 @@ private slots:
     void onUploadClicked();
     void onConnectClicked();
     void onResultReceived(QString imageId, QString extractedText, bool success, QString errorMessage);
+    void onProgressReceived(QString imageId, QString stage, int percent);
     void onConnectionStatusChanged(bool connected);
     void onConnectionError(QString errorMessage);
 
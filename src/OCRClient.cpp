@@ -115,6 +115,7 @@ void OCRClient::sendImage(const QString& imageId, const QString& filename, const
         request.set_image_id(imageId.toStdString());
         request.set_filename(filename.toStdString());
         request.set_image_data(imageData.constData(), imageData.size());
+        request.set_report_progress(true);
 
         // Add to queue instead of blocking
         {
@@ -178,12 +179,30 @@ void OCRClient::processSendQueue() {
     qDebug() << "Writer thread ended";
 }
 
+static QString progressStageName(ocr::ProgressStage stage) {
+    switch (stage) {
+        case ocr::PROGRESS_PREPROCESSING: return "Preprocessing";
+        case ocr::PROGRESS_RECOGNIZING: return "Recognizing";
+        case ocr::PROGRESS_RETRYING: return "Retrying";
+        case ocr::PROGRESS_POSTPROCESSING: return "Finishing";
+        default: return "Processing";
+    }
+}
+
 void OCRClient::processResults() {
     ocr::OCRResult result;
 
     try {
         while (m_running && m_stream->Read(&result)) {
             QString imageId = QString::fromStdString(result.image_id());
+
+            // Interim message while the server works on a slow image
+            if (result.has_progress()) {
+                emit progressReceived(imageId, progressStageName(result.progress().stage()),
+                                      result.progress().percent());
+                continue;
+            }
+
             QString text = QString::fromStdString(result.extracted_text());
             bool success = result.success();
             QString errorMsg = QString::fromStdString(result.error_message());
@@ -30,6 +30,7 @@ public:
 
 signals:
     void resultReceived(QString imageId, QString extractedText, bool success, QString errorMessage);
+    void progressReceived(QString imageId, QString stage, int percent);
     void connectionStatusChanged(bool connected);
     void connectionError(QString errorMessage);
 
@@ -0,0 +1,652 @@
+#include "OCRPipeline.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+
+// Images decoded at once for worker processes, at most
+static const size_t IMAGE_ARENA_BYTES = size_t(1) << 30;
+
+// One recognizer thread per processor, across all profiles
+static size_t totalProcessors(const PipelineConfig& config) {
+    size_t total = config.recognizeThreads;
+    for (const auto& entry : config.profileProcessors) {
+        total += entry.second;
+    }
+    return total;
+}
+
+static std::shared_ptr<const TrainedData> loadModel(const std::string& tessdataPath) {
+    std::shared_ptr<const TrainedData> model = TrainedData::load(tessdataPath);
+    if (model) {
+        std::cout << "Loaded model " << model->path() << " (" << model->size() / (1024 * 1024) << " MB)" << std::endl;
+    } else {
+        std::cerr << "Cannot find eng.traineddata" << (tessdataPath.empty() ? "" : " in " + tessdataPath)
+                  << ", every processor will load its own" << std::endl;
+    }
+    return model;
+}
+
+// Builds count processors for profile on builders' threads side by side
+static std::vector<std::unique_ptr<OCRProcessor>> buildProcessors(ThreadPool& builders, const OCRProfile& profile,
+                                                                  size_t count, const EngineOptions& engine,
+                                                                  const CascadeOptions& cascade, bool warmUp) {
+    auto start = std::chrono::steady_clock::now();
+    int64_t residentBefore = processResidentBytes();
+
+    std::vector<std::unique_ptr<OCRProcessor>> processors(count);
+    std::vector<double> warmUpMs(count, 0.0);
+    for (size_t i = 0; i < count; ++i) {
+        builders.enqueue([&, i]() {
+            auto processor = std::make_unique<OCRProcessor>();
+            if (processor->initialize(profile, cascade, engine)) {
+                if (warmUp) {
+                    warmUpMs[i] = processor->warmUp();
+                }
+                processors[i] = std::move(processor);
+            }
+        });
+    }
+    builders.waitAll();
+
+    double initMs = 0.0;
+    double totalWarmUpMs = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        if (processors[i]) {
+            initMs += processors[i]->initMs();
+            totalWarmUpMs += warmUpMs[i];
+        }
+    }
+    processors.erase(std::remove(processors.begin(), processors.end(), nullptr), processors.end());
+    if (!processors.empty()) {
+        int64_t initialized = static_cast<int64_t>(processors.size());
+        int64_t residentAfter = processResidentBytes();
+        int64_t grown = residentBefore > 0 && residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+        std::cout << "Initialized " << initialized << " " << profile.name << " processors in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms (" << initMs / initialized << " ms and "
+                  << grown / initialized / (1024 * 1024) << " MB each";
+        if (warmUp) {
+            std::cout << ", warm-up " << totalWarmUpMs / initialized << " ms";
+        }
+        std::cout << ")" << std::endl;
+    }
+    return processors;
+}
+
+// Starts count worker processes for profile, which all initialize at once
+static std::vector<std::unique_ptr<WorkerProcess>> startWorkers(const OCRProfile& profile, size_t count,
+                                                                const PreparedProcessors& prepared,
+                                                                bool warmUp) {
+    auto start = std::chrono::steady_clock::now();
+    WorkerProcess::Setup setup{&profile, prepared.engine, prepared.cascade, warmUp};
+    setup.images = prepared.images;
+
+    std::vector<std::unique_ptr<WorkerProcess>> workers;
+    for (size_t i = 0; i < count; ++i) {
+        auto worker = std::make_unique<WorkerProcess>(setup);
+        if (worker->start()) {
+            workers.push_back(std::move(worker));
+        }
+    }
+    workers.erase(std::remove_if(workers.begin(), workers.end(),
+                                 [](const std::unique_ptr<WorkerProcess>& worker) { return !worker->waitReady(); }),
+                  workers.end());
+    if (!workers.empty()) {
+        std::cout << "Started " << workers.size() << " " << profile.name << " worker processes in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+    }
+    return workers;
+}
+
+// Processors for profile in this process, or worker processes
+static PreparedPool preparePool(ThreadPool& builders, const OCRProfile& profile, size_t count,
+                                const PipelineConfig& config, const PreparedProcessors& prepared) {
+    PreparedPool pool;
+    pool.profile = &profile;
+    if (config.workerProcesses) {
+        pool.workers = startWorkers(profile, count, prepared, config.warmUp);
+    } else {
+        pool.processors = buildProcessors(builders, profile, count, prepared.engine, prepared.cascade, config.warmUp);
+    }
+    return pool;
+}
+
+PreparedProcessors OCRPipeline::prepareProcessors(const PipelineConfig& config) {
+    PreparedProcessors prepared;
+    prepared.engine = config.engine;
+    prepared.cascade = config.cascade;
+
+    // Every processor, including the ones releaseProcessor() recreates, is
+    // initialized from these instead of reading the model files again, and
+    // whole-page processors share one orientation detector. Worker
+    // processes map the files themselves.
+    if (!config.workerProcesses) {
+        prepared.engine.model = loadModel(prepared.engine.tessdataPath);
+        if (prepared.cascade.enabled && !prepared.cascade.fastModelPath.empty()) {
+            prepared.cascade.fastModel = loadModel(prepared.cascade.fastModelPath);
+        }
+        prepared.engine.osd = OrientationDetector::create(
+            prepared.engine.model ? prepared.engine.model->directory() : prepared.engine.tessdataPath);
+        if (prepared.engine.osd) {
+            std::cout << "Loaded orientation model " << prepared.engine.osd->path() << std::endl;
+        }
+    }
+
+    // Worker processes read images from where the decode stage put them.
+    // Address space only, like their channels: pages are allocated as
+    // images touch them. One per process, shared by every pipeline.
+    if (config.workerProcesses && PixMemoryPool::installed()) {
+        static SharedImageArena* images = []() {
+            SharedImageArena* arena = SharedImageArena::create(IMAGE_ARENA_BYTES);
+            PixMemoryPool::setArena(arena);
+            return arena;
+        }();
+        prepared.images = images;
+    }
+
+    // Joined on return, so no threads outlive the preparation
+    size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+    ThreadPool builders(config.workerProcesses ? 1 : std::min(cores, totalProcessors(config)));
+
+    const OCRProfile* defaultProfile = findProfile("");
+    PreparedPool pool = preparePool(builders, *defaultProfile, config.recognizeThreads, config, prepared);
+    if (pool.processors.empty() && pool.workers.empty()) {
+        throw std::runtime_error("Failed to initialize any OCR processors");
+    }
+    prepared.pools.push_back(std::move(pool));
+
+    for (const auto& entry : config.profileProcessors) {
+        const OCRProfile* profile = findProfile(entry.first);
+        if (!profile) {
+            std::cerr << "Ignoring unknown OCR profile: " << entry.first << std::endl;
+        } else if (profile != defaultProfile && entry.second > 0) {
+            pool = preparePool(builders, *profile, entry.second, config, prepared);
+            if (pool.processors.empty() && pool.workers.empty()) {
+                std::cerr << "No processors for OCR profile " << profile->name << ", it will be unavailable" << std::endl;
+            } else {
+                prepared.pools.push_back(std::move(pool));
+            }
+        }
+    }
+    prepared.warmedUp = config.warmUp;
+    return prepared;
+}
+
+void OCRPipeline::warmUpProcessors(PreparedProcessors& prepared) {
+    auto start = std::chrono::steady_clock::now();
+    size_t warmed = 0;
+    for (auto& pool : prepared.pools) {
+        for (auto& processor : pool.processors) {
+            processor->warmUp();
+            warmed++;
+        }
+    }
+    prepared.warmedUp = true;
+    if (warmed > 0) {
+        std::cout << "Warmed up " << warmed << " processors in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+    }
+}
+
+OCRPipeline::OCRPipeline(const PipelineConfig& config)
+    : OCRPipeline(config, prepareProcessors(config)) {
+}
+
+OCRPipeline::OCRPipeline(const PipelineConfig& config, PreparedProcessors prepared)
+    : m_generation(0)
+    , m_preprocess(config.preprocess)
+    , m_regionSplitPixels(config.regionSplitPixels)
+    , m_engine(prepared.engine)
+    , m_cascade(prepared.cascade)
+    , m_images(prepared.images)
+    , m_retryEmpty(config.retryEmpty)
+    , m_warmUp(config.warmUp)
+    , m_imageTimeoutMs(config.imageTimeoutMs)
+    , m_inFlight(0)
+    , m_decodeStage(config.decodeThreads, config.queueDepth)
+    , m_recognizeStage(totalProcessors(config), config.queueDepth)
+    , m_outputStage(config.outputThreads, config.queueDepth)
+    , m_restartStage(config.workerProcesses ? totalProcessors(config) : 0)
+    , m_admission(config.maxInFlight, m_decodeStage)
+{
+    if (prepared.pools.empty() || prepared.pools.front().profile != findProfile("")) {
+        throw std::runtime_error("No OCR processors for the default profile");
+    }
+    for (auto& pool : prepared.pools) {
+        addProcessors(std::move(pool));
+    }
+
+    // Processors prepared without warming up are warmed here, on the
+    // recognize stage's threads, which are idle until the pipeline runs.
+    // Nothing can reach the pipeline before the constructor returns.
+    if (m_warmUp && !prepared.warmedUp) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& pool : m_pools) {
+            for (const auto& slot : pool->slots) {
+                OCRProcessor* processor = slot->processor.get();
+                if (!processor) {
+                    continue;
+                }
+                m_recognizeStage.enqueue([processor]() {
+                    processor->warmUp();
+                });
+            }
+        }
+        m_recognizeStage.waitAll();
+        std::cout << "Warmed up " << processorCount() << " processors in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+    }
+
+    if (!config.lexiconPath.empty()) {
+        m_lexicon = Lexicon::open(config.lexiconPath);
+        if (m_lexicon) {
+            std::cout << "Loaded lexicon " << config.lexiconPath << " (" << m_lexicon->size() << " words)" << std::endl;
+        }
+    }
+}
+
+void OCRPipeline::addProcessors(PreparedPool prepared) {
+    auto pool = std::make_unique<ProcessorPool>(*prepared.profile, m_recognizeStage);
+    for (auto& processor : prepared.processors) {
+        pool->slots.push_back(std::make_unique<ProcessorSlot>(ProcessorSlot{std::move(processor), 0, pool.get(), nullptr}));
+    }
+    for (auto& worker : prepared.workers) {
+        pool->slots.push_back(std::make_unique<ProcessorSlot>(ProcessorSlot{nullptr, 0, pool.get(), std::move(worker)}));
+    }
+    for (const auto& slot : pool->slots) {
+        pool->idle.push_back(slot.get());
+        pool->available.release();
+    }
+    m_pools.push_back(std::move(pool));
+}
+
+OCRPipeline::ProcessorPool* OCRPipeline::poolFor(const std::string& profile) const {
+    const OCRProfile* wanted = findProfile(profile);
+    for (const auto& pool : m_pools) {
+        if (&pool->profile == wanted) {
+            return pool.get();
+        }
+    }
+    return nullptr;
+}
+
+bool OCRPipeline::hasProfile(const std::string& name) const {
+    return poolFor(name) != nullptr;
+}
+
+RetryStats OCRPipeline::retryStats() const {
+    return RetryStats{m_retried.load(), m_recovered.load(), m_retriesSkipped.load()};
+}
+
+void OCRPipeline::recordTimeout() {
+    std::lock_guard<std::mutex> lock(m_timeoutMutex);
+    m_timeouts++;
+    m_recentTimeouts.push_back(std::chrono::steady_clock::now());
+}
+
+TimeoutStats OCRPipeline::timeoutStats() {
+    std::lock_guard<std::mutex> lock(m_timeoutMutex);
+    auto hourAgo = std::chrono::steady_clock::now() - std::chrono::hours(1);
+    while (!m_recentTimeouts.empty() && m_recentTimeouts.front() < hourAgo) {
+        m_recentTimeouts.pop_front();
+    }
+    return TimeoutStats{m_timeouts, m_recentTimeouts.size()};
+}
+
+size_t OCRPipeline::processorCount() const {
+    size_t count = 0;
+    for (const auto& pool : m_pools) {
+        count += pool->slots.size();
+    }
+    return count;
+}
+
+OCRPipeline::~OCRPipeline() {
+    waitAll();
+    {
+        std::lock_guard<std::mutex> lock(m_restartMutex);
+        m_stopping = true;
+    }
+    m_restartBackoff.notify_all();
+}
+
+void OCRPipeline::waitAll() {
+    {
+        std::unique_lock<std::mutex> lock(m_inFlightMutex);
+        m_inFlightDone.wait(lock, [this]() { return m_inFlight == 0; });
+    }
+
+    // The last job may still be unwinding on an output thread
+    m_decodeStage.waitAll();
+    m_recognizeStage.waitAll();
+    m_outputStage.waitAll();
+}
+
+Task OCRPipeline::process(std::shared_ptr<OCRJob> job) {
+    // Unknown names are reported to clients by the service, which checks
+    // hasProfile() first; no job runs under a profile it didn't ask for
+    ProcessorPool* pool = poolFor(job->profile);
+    if (!pool) {
+        job->fail("Unknown or disabled OCR profile: " + job->profile);
+        co_return;
+    }
+    const OCRProfile& profile = pool->profile;
+
+    {
+        std::lock_guard<std::mutex> lock(m_inFlightMutex);
+        m_inFlight++;
+    }
+
+    // Decode/preprocess
+    co_await m_decodeStage.schedule();
+    job->report(JobStage::Preprocessing, 0);
+    if (job->binarization == BinarizationMode::Default) {
+        job->binarization = m_preprocess.binarization;
+    }
+
+    auto decodeStart = std::chrono::high_resolution_clock::now();
+    try {
+        PreprocessOptions options = OCRProcessor::preprocessOptionsFor(profile, m_preprocess);
+        options.binarization = job->binarization;
+        PixMemoryPool::ArenaScope shared(m_images != nullptr);
+        job->image = OCRProcessor::decodeImage(job->imageData, job->filename, options, &job->preprocess,
+                                               m_retryEmpty ? &job->decoded : nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception decoding " << job->filename << ": " << e.what() << std::endl;
+    }
+    job->decodeMs = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - decodeStart).count();
+
+    // Recognize, only if there is something to recognize
+    if (job->image) {
+        co_await m_recognizeStage.schedule();
+        co_await pool->available.acquire();
+        ProcessorSlot* slot = takeIdleProcessor(*pool);
+
+        auto recognizeStart = std::chrono::high_resolution_clock::now();
+        job->report(JobStage::Recognizing, 0);
+        job->monitor.start(m_imageTimeoutMs);
+        if (job->onProgress) {
+            // The monitor lives in the job, so a raw pointer can't dangle
+            OCRJob* raw = job.get();
+            job->monitor.onProgress = [raw](int percent) { raw->report(JobStage::Recognizing, percent); };
+        }
+
+        // Large upright pages are split into text blocks. Pages that still
+        // need OSD are left whole, since block boxes would be unrotated.
+        std::vector<TextRegion> regions;
+        size_t pixels = static_cast<size_t>(pixGetWidth(job->image)) * pixGetHeight(job->image);
+        if (profile.wholePage && m_regionSplitPixels > 0 && pixels >= m_regionSplitPixels &&
+            !job->preprocess.needsOSD && !job->preprocess.singleBlock && pool->slots.size() > 1) {
+            try {
+                regions = slot->worker ? slot->worker->analyzeLayout(job->image, job->filename)
+                                       : slot->processor->analyzeLayout(job->image, job->filename);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception analyzing layout of " << job->filename << ": " << e.what() << std::endl;
+                job->error = e.what();
+            }
+        }
+
+        if (!job->error.empty()) {
+            releaseProcessor(slot);
+        } else if (regions.size() > 1) {
+            // This processor goes back to the pool to take a share of the blocks
+            releaseProcessor(slot);
+            co_await recognizeRegions(job, pool, std::move(regions));
+        } else {
+            try {
+                tesseract::PageSegMode pageSegMode = OCRProcessor::pageSegModeFor(profile, job->preprocess);
+                job->text = slot->worker
+                    ? slot->worker->recognize(job->image, job->filename, pageSegMode, job->preprocess.textHeight,
+                                              &job->cascade, &job->monitor)
+                    : slot->processor->recognize(job->image, job->filename, pageSegMode, job->preprocess.textHeight,
+                                                 &job->cascade, &job->monitor);
+            } catch (const std::exception& e) {
+                std::cerr << "Exception in OCR processing for " << job->filename << ": " << e.what() << std::endl;
+                job->text = "";
+                job->error = e.what();
+            }
+            releaseProcessor(slot);
+        }
+        job->recognizeMs = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - recognizeStart).count();
+        if (job->monitor.expired) {
+            std::cerr << "Recognition of " << job->filename << " cancelled after " << job->recognizeMs << "ms" << std::endl;
+            job->text.clear();
+            recordTimeout();
+        }
+
+        pixDestroy(&job->image);
+    }
+    
+    // Images that failed preprocessing get the same second chance; images
+    // that never decoded, ran out of time, or crashed a worker have had
+    // their share
+    if (job->decoded && !job->preprocess.noText && !job->monitor.expired && job->error.empty() &&
+        OCRProcessor::postProcessText(job->text).empty()) {
+        co_await retryAlternatePreprocessing(job, pool);
+    }
+    if (job->decoded) {
+        pixDestroy(&job->decoded);
+    }
+
+    // Post-process
+    co_await m_outputStage.schedule();
+    job->report(JobStage::PostProcessing, 0);
+    try {
+        // Profiles that recognize without dictionaries are reading codes and
+        // numbers, which a word list would only damage
+        job->text = OCRProcessor::postProcessText(job->text, profile.dictionaries ? m_lexicon.get() : nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception post-processing " << job->filename << ": " << e.what() << std::endl;
+        job->text = "";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_inFlightMutex);
+        m_inFlight--;
+    }
+    m_inFlightDone.notify_all();
+}
+
+Task OCRPipeline::recognizeRegions(std::shared_ptr<OCRJob> job, ProcessorPool* pool, std::vector<TextRegion> regions) {
+    std::vector<std::string> texts(regions.size());
+    std::atomic<size_t> finished{0};
+
+    TaskGroup group;
+    for (size_t i = 0; i < regions.size(); ++i) {
+        group.spawn(recognizeRegion(job, pool, regions[i], &texts[i], &finished, regions.size()));
+    }
+    co_await group.wait();
+
+    // A page with a missing block fails as a whole, like one that failed
+    // in one piece
+    job->text.clear();
+    if (!job->error.empty()) {
+        co_return;
+    }
+
+    // Reassemble in the reading order layout analysis returned
+    for (const auto& text : texts) {
+        if (text.empty()) {
+            continue;
+        }
+        if (!job->text.empty()) {
+            job->text += "\n";
+        }
+        job->text += text;
+    }
+}
+
+Task OCRPipeline::recognizeRegion(std::shared_ptr<OCRJob> job, ProcessorPool* pool, TextRegion region,
+                                  std::string* text, std::atomic<size_t>* finished, size_t total) {
+    // Hop onto the pool first so the blocks really run side by side
+    co_await m_recognizeStage.schedule();
+    co_await pool->available.acquire();
+    ProcessorSlot* slot = takeIdleProcessor(*pool);
+
+    try {
+        *text = slot->worker ? slot->worker->recognizeRegion(job->image, region, job->filename, &job->monitor)
+                             : slot->processor->recognizeRegion(job->image, region, job->filename, &job->monitor);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception recognizing region of " << job->filename << ": " << e.what() << std::endl;
+        job->fail(e.what());
+    }
+
+    releaseProcessor(slot);
+    job->report(JobStage::Recognizing, static_cast<int>(100 * (*finished += 1) / total));
+}
+
+Task OCRPipeline::retryAlternatePreprocessing(std::shared_ptr<OCRJob> job, ProcessorPool* pool) {
+    PreprocessOptions options = OCRProcessor::preprocessOptionsFor(pool->profile, m_preprocess);
+    options.binarization = job->binarization;
+    std::vector<PreprocessVariant> variants = alternatePreprocessing(options);
+
+    // A permit that is free right now means no image is waiting for it
+    std::vector<ProcessorSlot*> slots;
+    while (slots.size() < variants.size() && pool->available.tryAcquire()) {
+        slots.push_back(takeIdleProcessor(*pool));
+    }
+    if (slots.empty()) {
+        m_retriesSkipped++;
+        co_return;
+    }
+
+    m_retried++;
+    job->report(JobStage::Retrying, 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<VariantResult> results(slots.size());
+    
+    // A variant that runs out of time just doesn't win
+    RecognitionMonitor monitor;
+    monitor.start(m_imageTimeoutMs);
+    TaskGroup group;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        group.spawn(recognizeVariant(job, slots[i], variants[i], &monitor, &results[i]));
+    }
+    co_await group.wait();
+
+    // Text post-processing would throw away doesn't count, however confident
+    const VariantResult* best = nullptr;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const VariantResult& result = results[i];
+        if ((!best || result.confidence > best->confidence) && !OCRProcessor::postProcessText(result.text).empty()) {
+            best = &result;
+            job->retry.recoveredBy = variants[i].name;
+        }
+    }
+
+    job->retry.variantsRun = static_cast<int>(results.size());
+    job->retry.ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    if (best) {
+        job->text = best->text;
+        job->retry.confidence = best->confidence;
+        m_recovered++;
+    }
+}
+
+Task OCRPipeline::recognizeVariant(std::shared_ptr<OCRJob> job, ProcessorSlot* slot, PreprocessVariant variant,
+                                   RecognitionMonitor* monitor, VariantResult* result) {
+    co_await m_recognizeStage.schedule();
+
+    try {
+        // A copy rather than a clone: Leptonica's reference counts aren't
+        // atomic, and the variants run side by side
+        PreprocessInfo info;
+        Pix* image = runPreprocessStages(pixCopy(nullptr, job->decoded), variant.options, info);
+        if (image) {
+            tesseract::PageSegMode pageSegMode = OCRProcessor::pageSegModeFor(slot->pool->profile, info);
+            result->text = slot->worker
+                ? slot->worker->recognizeWithConfidence(image, job->filename, pageSegMode, result->confidence, monitor)
+                : slot->processor->recognizeWithConfidence(image, job->filename, pageSegMode, result->confidence,
+                                                           monitor);
+            pixDestroy(&image);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception retrying " << job->filename << " " << variant.name << ": " << e.what() << std::endl;
+    }
+
+    releaseProcessor(slot);
+}
+
+void OCRPipeline::recycleProcessors() {
+    m_generation++;
+
+    // Idle processors are replaced right away; busy ones on release
+    for (const auto& pool : m_pools) {
+        if (!pool->slots.empty() && pool->slots.front()->worker) {
+            continue;
+        }
+        std::vector<ProcessorSlot*> idle;
+        while (pool->available.tryAcquire()) {
+            idle.push_back(takeIdleProcessor(*pool));
+        }
+        for (ProcessorSlot* slot : idle) {
+            releaseProcessor(slot);
+        }
+    }
+}
+
+OCRPipeline::ProcessorSlot* OCRPipeline::takeIdleProcessor(ProcessorPool& pool) {
+    // Callers hold a permit from pool.available, so this never fails
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    ProcessorSlot* slot = pool.idle.back();
+    pool.idle.pop_back();
+    return slot;
+}
+
+void OCRPipeline::releaseProcessor(ProcessorSlot* slot) {
+    int generation = m_generation.load();
+    if (slot->worker) {
+        // A crashed worker is restarted off the recognize threads, and only
+        // rejoins the pool once it is running again
+        if (!slot->worker->alive()) {
+            m_restartStage.enqueue([this, slot]() { restartWorker(slot); });
+            return;
+        }
+    } else if (slot->generation != generation) {
+        // Recreate processor to clear Tesseract memory
+        auto processor = std::make_unique<OCRProcessor>();
+        if (processor->initialize(slot->pool->profile, m_cascade, m_engine)) {
+            // Before it is idle again, so no image pays for the first use
+            if (m_warmUp) {
+                processor->warmUp();
+            }
+            slot->processor = std::move(processor);
+        } else {
+            std::cerr << "Failed to recycle OCR processor, keeping the old instance" << std::endl;
+        }
+        slot->generation = generation;
+    }
+    makeIdle(slot);
+}
+
+// Tries again, less and less often, until the worker runs; meanwhile its
+// slot stays out of the pool so no image is sent to it
+void OCRPipeline::restartWorker(ProcessorSlot* slot) {
+    const std::chrono::milliseconds MAX_BACKOFF(30000);
+    std::chrono::milliseconds backoff(100);
+    while (!slot->worker->restart()) {
+        std::cerr << "Failed to restart OCR worker process, trying again in " << backoff.count() << "ms" << std::endl;
+        std::unique_lock<std::mutex> lock(m_restartMutex);
+        if (m_restartBackoff.wait_for(lock, backoff, [this]() { return m_stopping; })) {
+            return;
+        }
+        backoff = std::min(backoff * 2, MAX_BACKOFF);
+    }
+    makeIdle(slot);
+}
+
+void OCRPipeline::makeIdle(ProcessorSlot* slot) {
+    {
+        std::lock_guard<std::mutex> lock(slot->pool->mutex);
+        slot->pool->idle.push_back(slot);
+    }
+    slot->pool->available.release();
+}
\ No newline at end of file
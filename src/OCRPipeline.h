@@ -0,0 +1,285 @@
+#ifndef OCRPIPELINE_H
+#define OCRPIPELINE_H
+
+#include "OCRProcessor.h"
+#include "WorkerProcess.h"
+#include "ThreadPool.h"
+#include "Coroutine.h"
+#include <string>
+#include <memory>
+#include <vector>
+#include <map>
+#include <functional>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// How retrying an empty result went for one image
+struct RetryResult {
+    int variantsRun = 0;        // Alternate preprocessings recognized; 0 if not retried
+    std::string recoveredBy;    // PreprocessVariant::name of the text used, if any
+    int confidence = -1;        // Of that text
+    double ms = 0.0;
+};
+
+// Empty results retried since startup
+struct RetryStats {
+    uint64_t retried;           // Images retried on idle processors
+    uint64_t recovered;         // ... that then produced text
+    uint64_t skipped;           // Empty results with no idle processor to retry on
+};
+
+// Images cancelled for running past PipelineConfig::imageTimeoutMs
+struct TimeoutStats {
+    uint64_t total;             // Since startup
+    uint64_t lastHour;
+};
+
+// Where a job is, for progress reports
+enum class JobStage {
+    Preprocessing,
+    Recognizing,
+    Retrying,               // Alternate preprocessing after an empty result
+    PostProcessing
+};
+
+// One image travelling through the pipeline. Each stage fills in the
+// fields it produces before the job moves on to the next stage.
+struct OCRJob {
+    std::string imageId;
+    std::string filename;
+    std::string imageData;
+    BinarizationMode binarization = BinarizationMode::Default;
+    std::string profile;        // OCRProfile name; empty for the default
+    // Optional; called on pipeline threads as the job moves along and, while
+    // recognizing, with the percentage done so far
+    std::function<void(JobStage stage, int percent)> onProgress;
+
+    Pix* image = nullptr;       // Set by the decode stage
+    Pix* decoded = nullptr;     // Set by the decode stage, before preprocessing, if empty
+                                // results are retried; kept until they are
+    PreprocessInfo preprocess;  // Set by the decode stage
+    CascadeResult cascade;      // Set by the recognize stage
+    RetryResult retry;          // Set by the recognize stage
+    RecognitionMonitor monitor; // Started when the recognize stage gets a processor
+    std::string text;           // Set by the recognize/output stages
+    std::string error;          // Why recognition failed, if it did (a worker crash)
+
+    double decodeMs = 0.0;      // Wall time spent in each stage
+    double recognizeMs = 0.0;
+
+    void report(JobStage stage, int percent) const {
+        if (onProgress) {
+            onProgress(stage, percent);
+        }
+    }
+
+    // Records the first failure; regions of one page can fail side by side
+    void fail(const std::string& why) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (error.empty()) {
+            error = why;
+        }
+    }
+    std::mutex errorMutex;
+
+    ~OCRJob() {
+        if (image) {
+            pixDestroy(&image);
+        }
+        if (decoded) {
+            pixDestroy(&decoded);
+        }
+    }
+};
+
+struct PipelineConfig {
+    size_t recognizeThreads = 4;    // OCRProcessors for the page profile
+    std::map<std::string, size_t> profileProcessors;  // Warm processors for the other
+                                                      // profiles, e.g. {"word", 2}; each
+                                                      // is a Tesseract instance of its own,
+                                                      // so none are served by default
+    size_t decodeThreads = 2;
+    size_t outputThreads = 1;
+    size_t queueDepth = 8;          // Jobs waiting in front of each stage
+    size_t maxInFlight = 1024;      // Admitted but unfinished images, all clients
+    PreprocessOptions preprocess;   // binarization is the server default
+    size_t regionSplitPixels = 8000000; // Larger pages are recognized block by block
+                                        // on several processors; 0 disables
+    std::string lexiconPath;        // Lexicon::build file; confusable digits are
+                                    // only corrected with one
+    EngineOptions engine;           // Engine mode and model for every processor
+    CascadeOptions cascade;         // Fast first pass for whole pages
+    int imageTimeoutMs = 60000;     // Recognition time per image before Tesseract is
+                                    // cancelled, so no image can hold a processor for
+                                    // long; 0 disables
+    bool retryEmpty = true;         // Re-recognize images that yield no text with
+                                    // alternate preprocessing, on idle processors only
+    bool warmUp = true;             // Run every new processor, including recycled ones,
+                                    // on a synthetic page before it takes images
+    bool recycleProcessors = true;  // Replace every processor periodically to give back
+                                    // what Tesseract holds on to (OCRServiceImpl)
+    bool workerProcesses = false;   // Run each processor in a process of its own, so a
+                                    // crash fails one image instead of the server.
+                                    // POSIX only.
+};
+
+// The processors for one profile: in this process, or with
+// PipelineConfig::workerProcesses, one worker process each
+struct PreparedPool {
+    const OCRProfile* profile = nullptr;
+    std::vector<std::unique_ptr<OCRProcessor>> processors;
+    std::vector<std::unique_ptr<WorkerProcess>> workers;
+};
+
+// Processors for every profile a config enables, initialized ahead of an
+// OCRPipeline, with the models they were loaded from. Preparing them
+// leaves no threads running, so the process holding them can fork and
+// hand them to a pipeline in the child (OCRServer's zygote mode).
+struct PreparedProcessors {
+    EngineOptions engine;
+    CascadeOptions cascade;
+    std::vector<PreparedPool> pools;    // The default profile's pool first
+    bool warmedUp = false;
+    SharedImageArena* images = nullptr; // Decoded images shared with worker processes
+};
+
+// Decode/preprocess -> recognize -> postprocess, each stage running on its
+// own ThreadPool with a bounded queue in front of it. Only the recognize
+// stage holds an OCRProcessor, so Tesseract instances are never reserved
+// while an image is being decoded or its text is being cleaned up.
+//
+// Jobs are coroutines: a job waiting for a full stage queue or a free
+// processor is suspended rather than parking a thread.
+//
+// Each enabled OCRProfile has its own pool of initialized processors, and
+// a job only ever waits for a processor of its own profile.
+//
+// An image that yields no usable text is tried again with alternate
+// preprocessing of the image as decoded, one variant per processor that is
+// idle at that moment, and the most confident result wins. Retries never
+// wait for a processor, so they only use capacity nobody else wants.
+//
+// With worker processes images are decoded into memory the workers share,
+// and a processor that crashes or hangs fails only the image it was
+// recognizing. It is restarted on a thread of its own and
+// rejoins its pool once it is running again.
+class OCRPipeline {
+public:
+    explicit OCRPipeline(const PipelineConfig& config);
+    OCRPipeline(const PipelineConfig& config, PreparedProcessors prepared);
+    ~OCRPipeline();
+
+    // Runs the job through every stage; completes on an output thread. A
+    // job for a profile hasProfile() rejects fails at once, with an error.
+    Task process(std::shared_ptr<OCRJob> job);
+
+    // Admission control for callers: suspends while maxInFlight images are
+    // already admitted. Every admit() must be paired with a release().
+    auto admit() { return m_admission.acquire(); }
+    void release() { m_admission.release(); }
+
+    // Replaces every processor with a fresh instance. Processors that are
+    // busy are replaced as soon as they finish their current image. Worker
+    // processes are left alone: all of their memory goes when they exit.
+    void recycleProcessors();
+
+    // Initializes config's processors, several at a time, and warms them
+    // up if config asks for it
+    static PreparedProcessors prepareProcessors(const PipelineConfig& config);
+    // Warms up processors prepared without it, one after another on the
+    // calling thread
+    static void warmUpProcessors(PreparedProcessors& prepared);
+
+    size_t processorCount() const;
+    bool hasProfile(const std::string& name) const;
+    RetryStats retryStats() const;
+    TimeoutStats timeoutStats();
+    void waitAll();
+
+private:
+    struct ProcessorPool;
+
+    struct ProcessorSlot {
+        std::unique_ptr<OCRProcessor> processor;
+        int generation;
+        ProcessorPool* pool;
+        std::unique_ptr<WorkerProcess> worker;     // Instead of processor
+    };
+
+    // Processors initialized for one profile
+    struct ProcessorPool {
+        ProcessorPool(const OCRProfile& profile, ThreadPool& resumeOn)
+            : profile(profile)
+            , available(0, resumeOn) {
+        }
+
+        const OCRProfile& profile;
+        std::vector<std::unique_ptr<ProcessorSlot>> slots;
+        std::vector<ProcessorSlot*> idle;
+        std::mutex mutex;
+        AsyncSemaphore available;
+    };
+
+    void addProcessors(PreparedPool prepared);
+    ProcessorPool* poolFor(const std::string& profile) const;
+
+    Task recognizeRegions(std::shared_ptr<OCRJob> job, ProcessorPool* pool, std::vector<TextRegion> regions);
+    Task recognizeRegion(std::shared_ptr<OCRJob> job, ProcessorPool* pool, TextRegion region, std::string* text,
+                         std::atomic<size_t>* finished, size_t total);
+
+    struct VariantResult {
+        std::string text;
+        int confidence = -1;
+    };
+    Task retryAlternatePreprocessing(std::shared_ptr<OCRJob> job, ProcessorPool* pool);
+    Task recognizeVariant(std::shared_ptr<OCRJob> job, ProcessorSlot* slot, PreprocessVariant variant,
+                          RecognitionMonitor* monitor, VariantResult* result);
+    void recordTimeout();
+
+    ProcessorSlot* takeIdleProcessor(ProcessorPool& pool);
+    void releaseProcessor(ProcessorSlot* slot);
+    void makeIdle(ProcessorSlot* slot);
+    void restartWorker(ProcessorSlot* slot);
+
+    // m_pools[0] serves the default profile
+    std::vector<std::unique_ptr<ProcessorPool>> m_pools;
+    std::atomic<int> m_generation;
+    PreprocessOptions m_preprocess;
+    size_t m_regionSplitPixels;
+    EngineOptions m_engine;
+    CascadeOptions m_cascade;
+    SharedImageArena* m_images;
+    std::unique_ptr<Lexicon> m_lexicon;
+    bool m_retryEmpty;
+    bool m_warmUp;
+    std::atomic<uint64_t> m_retried{0};
+    std::atomic<uint64_t> m_recovered{0};
+    std::atomic<uint64_t> m_retriesSkipped{0};
+    int m_imageTimeoutMs;
+    std::mutex m_timeoutMutex;
+    std::deque<std::chrono::steady_clock::time_point> m_recentTimeouts;    // Within the last hour
+    uint64_t m_timeouts = 0;
+
+    std::mutex m_inFlightMutex;
+    std::condition_variable m_inFlightDone;
+    int m_inFlight;
+
+    std::mutex m_restartMutex;
+    std::condition_variable m_restartBackoff;
+    bool m_stopping = false;        // Workers that won't restart are given up on
+
+    // Declared after the processors so the stages drain before they go away
+    ThreadPool m_decodeStage;
+    ThreadPool m_recognizeStage;
+    ThreadPool m_outputStage;
+    ThreadPool m_restartStage;      // Restarts dead worker processes, one thread each so a
+                                    // worker that won't start holds up no other; none
+                                    // without worker processes
+
+    AsyncSemaphore m_admission;
+};
+
+#endif // OCRPIPELINE_H
\ No newline at end of file
@@ -1,11 +1,100 @@
 #include "OCRProcessor.h"
+#include "TextCorrector.h"
+#include <tesseract/ocrclass.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
 
-OCRProcessor::OCRProcessor() : m_initialized(false) {
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+static std::atomic<uint64_t> g_fastPasses{0};
+static std::atomic<uint64_t> g_accepted{0};      // Not escalated, nor out of time
+static std::atomic<uint64_t> g_escalations{0};
+static std::atomic<uint64_t> g_fastMicros{0};
+static std::atomic<uint64_t> g_fullMicros{0};   // Full passes after an escalation
+
+// Tesseract asks the progress monitor whether to stop after every word
+static bool cancelWhenExpired(void* monitor, int /*words*/) {
+    return static_cast<RecognitionMonitor*>(monitor)->check();
+}
+
+// ... and tells it how far it has got after every word
+static bool forwardProgress(ETEXT_DESC* progress, int /*left*/, int /*right*/, int /*top*/, int /*bottom*/) {
+    static_cast<RecognitionMonitor*>(progress->cancel_this)->reportProgress(progress->progress);
+    return true;
+}
+
+// Recognizes the image set on tesseract, cancelling once monitor runs out
+// of time. Returns false if it was cancelled; whatever was found by then is
+// unused.
+static bool recognizeWithin(tesseract::TessBaseAPI& tesseract, RecognitionMonitor* monitor, bool reportProgress) {
+    if (!monitor) {
+        // GetUTF8Text() recognizes on demand
+        return true;
+    }
+    if (monitor->check()) {
+        return false;
+    }
+    ETEXT_DESC progress;
+    progress.cancel = cancelWhenExpired;
+    progress.cancel_this = monitor;
+    if (reportProgress && monitor->onProgress) {
+        progress.progress_callback2 = forwardProgress;
+    }
+    tesseract.Recognize(&progress);
+    return !monitor->expired;
+}
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int64_t processResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<int64_t>(counters.WorkingSetSize);
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        return static_cast<int64_t>(info.resident_size);
+    }
+    return 0;
+#else
+    // statm: total program size, then resident pages
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0;
+    int64_t resident = 0;
+    if (statm >> size >> resident) {
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+    return 0;
+#endif
+}
+
+OCRProcessor::OCRProcessor()
+    : m_profile(findProfile("")), m_initMs(0.0), m_initialized(false) {
 }
 
 OCRProcessor::~OCRProcessor() {
+    if (m_fastTesseract) {
+        m_fastTesseract->End();
+    }
     if (m_tesseract) {
         // More aggressive cleanup to prevent Tesseract memory leaks
         m_tesseract->Clear();
@@ -15,271 +104,537 @@ OCRProcessor::~OCRProcessor() {
 }
 
 bool OCRProcessor::initialize() {
-    m_tesseract = std::make_unique<tesseract::TessBaseAPI>();
+    return initialize(*findProfile(""));
+}
+
+bool OCRProcessor::initialize(const OCRProfile& profile, const CascadeOptions& cascade, const EngineOptions& engine) {
+    m_profile = &profile;
+    m_cascade = cascade;
+    auto start = std::chrono::high_resolution_clock::now();
     
-    if (m_tesseract->Init(NULL, "eng")) {
+    m_tesseract = std::make_unique<tesseract::TessBaseAPI>();
+    if (!initializeEngine(*m_tesseract, engine.model.get(), engine.tessdataPath, engine.engineMode)) {
         std::cerr << "Could not initialize Tesseract" << std::endl;
+        m_tesseract.reset();
         return false;
     }
     
-    // Try different page segmentation modes
-    m_tesseract->SetPageSegMode(tesseract::PSM_AUTO_OSD);
+    // Whole pages may need orientation detection, which the main engine
+    // leaves to a detector of its own
+    if (profile.wholePage || profile.pageSegMode == tesseract::PSM_AUTO_OSD) {
+        m_osd = engine.osd ? engine.osd
+                           : OrientationDetector::create(engine.model ? engine.model->directory() : engine.tessdataPath);
+        if (!m_osd) {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true)) {
+                std::cerr << "osd.traineddata not found, pages of unknown orientation will be recognized as they are"
+                          << std::endl;
+            }
+        }
+    }
+    
+    // Whole-page processors get a mode per image from preprocessing
+    m_tesseract->SetPageSegMode(profile.pageSegMode);
     
     // Improved configuration for better accuracy
-    m_tesseract->SetVariable("tessedit_char_blacklist", "|[]\\");
     m_tesseract->SetVariable("textord_min_linesize", "2.5");
     m_tesseract->SetVariable("textord_heavy_nr", "1");
     m_tesseract->SetVariable("edges_max_children_per_outline", "40");
     
-    // Keep some dictionaries for better word recognition
-    m_tesseract->SetVariable("load_system_dawg", "1");
-    m_tesseract->SetVariable("load_freq_dawg", "1");
-    m_tesseract->SetVariable("load_unambig_dawg", "1");
-    
-    // Disable the ones that cause memory issues
-    m_tesseract->SetVariable("load_punc_dawg", "0");
-    m_tesseract->SetVariable("load_number_dawg", "0");
-    m_tesseract->SetVariable("load_bigram_dawg", "0");
+    if (m_cascade.enabled && profile.wholePage && !m_cascade.fastModelPath.empty() && !initializeFastModel()) {
+        std::cerr << "Could not load the fast model from " << m_cascade.fastModelPath
+                  << ", the cascade will use the main model" << std::endl;
+    }
     
+    m_initMs = elapsedMs(start);
     m_initialized = true;
     return true;
 }
 
-std::string OCRProcessor::processImage(const std::string& imageData, const std::string& filename) {
+// Tesseract reads the load_*_dawg parameters while loading the model;
+// setting them with SetVariable afterwards, as this used to, still loads
+// every dictionary. The character filter can change at any time.
+bool OCRProcessor::initializeEngine(tesseract::TessBaseAPI& tesseract, const TrainedData* model,
+                                    const std::string& tessdataPath, tesseract::OcrEngineMode engineMode) {
+    const char* dictionaries = m_profile->dictionaries ? "1" : "0";
+    std::vector<std::string> names = {
+        "load_system_dawg", "load_freq_dawg", "load_unambig_dawg",
+        // Disable the ones that cause memory issues
+        "load_punc_dawg", "load_number_dawg", "load_bigram_dawg"
+    };
+    std::vector<std::string> values = {dictionaries, dictionaries, dictionaries, "0", "0", "0"};
+    int failed = model
+        ? tesseract.Init(model->data(), model->size(), "eng", engineMode, nullptr, 0, &names, &values, false, nullptr)
+        : tesseract.Init(tessdataPath.empty() ? nullptr : tessdataPath.c_str(), "eng", engineMode,
+                         nullptr, 0, &names, &values, false);
+    if (failed) {
+        return false;
+    }
+    
+    if (m_profile->whitelist.empty()) {
+        tesseract.SetVariable("tessedit_char_blacklist", "|[]\\");
+    } else {
+        tesseract.SetVariable("tessedit_char_whitelist", m_profile->whitelist.c_str());
+    }
+    return true;
+}
+
+// tessdata_fast models are LSTM only
+bool OCRProcessor::initializeFastModel() {
+    m_fastTesseract = std::make_unique<tesseract::TessBaseAPI>();
+    if (!initializeEngine(*m_fastTesseract, m_cascade.fastModel.get(), m_cascade.fastModelPath,
+                          tesseract::OEM_LSTM_ONLY)) {
+        m_fastTesseract.reset();
+        return false;
+    }
+    return true;
+}
+
+// Ordinary text in Leptonica's built-in bitmap font, enough lines for
+// layout analysis, the LSTM and the dictionaries to do real work
+static Pix* renderWarmUpImage() {
+    static const char* TEXT = "Invoice 10045 dated 12 March 2024. The quick brown fox jumps over the lazy dog, "
+                              "then pays the total amount due on page 3 (see the customer address).";
+    const int WIDTH = 640;
+    const int HEIGHT = 200;
+    const int MARGIN = 20;
+    
+    L_BMF* font = bmfCreate(nullptr, 20);
+    if (!font) {
+        return nullptr;
+    }
+    Pix* image = pixCreate(WIDTH, HEIGHT, 8);
+    if (image) {
+        pixSetAllArbitrary(image, 255);
+        int overflow = 0;
+        pixSetTextblock(image, font, TEXT, 0, MARGIN, MARGIN, WIDTH - 2 * MARGIN, 0, &overflow);
+    }
+    bmfDestroy(&font);
+    return image;
+}
+
+double OCRProcessor::warmUp() {
     if (!m_initialized) {
-        std::cerr << "OCRProcessor not initialized for: " << filename << std::endl;
+        return 0.0;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    Pix* image = renderWarmUpImage();
+    if (!image) {
+        std::cerr << "Could not render the warm-up image" << std::endl;
+        return 0.0;
+    }
+    
+    // Not through the orientation detector: processors warm up side by side,
+    // and each would add an OSD engine to the one it was created with
+    tesseract::PageSegMode pageSegMode = m_profile->pageSegMode == tesseract::PSM_AUTO_OSD
+                                       ? tesseract::PSM_AUTO : m_profile->pageSegMode;
+    if (m_fastTesseract) {
+        runRecognition(*m_fastTesseract, image, pageSegMode, nullptr, nullptr);
+    }
+    runRecognition(*m_tesseract, image, pageSegMode, nullptr, nullptr);
+    pixDestroy(&image);
+    return elapsedMs(start);
+}
+
+std::string OCRProcessor::processImage(const std::string& imageData, const std::string& filename) {
+    PreprocessInfo info;
+    Pix* image = decodeImage(imageData, filename, preprocessOptionsFor(*m_profile, PreprocessOptions()), &info);
+    if (!image) {
         return "";
     }
     
+    std::string extractedText = recognize(image, filename, pageSegModeFor(*m_profile, info), info.textHeight);
+    pixDestroy(&image);
+    
+    return postProcessText(extractedText);
+}
+
+PreprocessOptions OCRProcessor::preprocessOptionsFor(const OCRProfile& profile, PreprocessOptions options) {
+    if (!profile.wholePage) {
+        options.fastOrientation = false;
+        options.cropToText = false;
+    }
+    options.singleLine = profile.singleLine;
+    return options;
+}
+
+tesseract::PageSegMode OCRProcessor::pageSegModeFor(const OCRProfile& profile, const PreprocessInfo& info) {
+    return profile.wholePage ? info.pageSegMode() : profile.pageSegMode;
+}
+
+Pix* OCRProcessor::decodeImage(const std::string& imageData, const std::string& filename,
+                               const PreprocessOptions& options, PreprocessInfo* info, Pix** unprocessed) {
     if (imageData.empty()) {
         std::cerr << "Empty image data for: " << filename << std::endl;
+        return nullptr;
+    }
+    
+    // Convert string data to Pix image
+    PreprocessInfo localInfo;
+    PreprocessInfo& cleanedInfo = info ? *info : localInfo;
+    Pix* cleanedImage = cleanImage(
+        reinterpret_cast<const unsigned char*>(imageData.data()), 
+        imageData.size(),
+        options,
+        cleanedInfo,
+        unprocessed
+    );
+    
+    if (!cleanedImage && !cleanedInfo.noText) {
+        std::cerr << "Failed to preprocess image: " << filename << std::endl;
+    }
+    
+    return cleanedImage;
+}
+
+std::string OCRProcessor::recognize(Pix* image, const std::string& filename, tesseract::PageSegMode pageSegMode,
+                                    int textHeight, CascadeResult* cascade, RecognitionMonitor* monitor) {
+    if (!m_initialized) {
+        std::cerr << "OCRProcessor not initialized for: " << filename << std::endl;
         return "";
     }
     
-    Pix* cleanedImage = nullptr;
+    CascadeResult localResult;
+    CascadeResult& result = cascade ? *cascade : localResult;
     
     try {
-        // Convert string data to Pix image
-        cleanedImage = cleanImage(
-            reinterpret_cast<const unsigned char*>(imageData.data()), 
-            imageData.size()
-        );
-        
-        if (!cleanedImage) {
-            std::cerr << "Failed to preprocess image: " << filename << std::endl;
-            return "";
+        // Progress counts the fast pass as the first part of the work, which
+        // it is whenever it escalates
+        const int FAST_PASS_PROGRESS = 30;
+        if (m_cascade.enabled && m_profile->wholePage) {
+            if (monitor) {
+                monitor->progressFirst = 0;
+                monitor->progressSpan = FAST_PASS_PROGRESS;
+            }
+            auto fastStart = std::chrono::high_resolution_clock::now();
+            std::string fastText = recognizeFast(image, pageSegMode, textHeight, result.fastConfidence, monitor);
+            result.ranFastPass = true;
+            result.fastMs = elapsedMs(fastStart);
+            g_fastPasses++;
+            g_fastMicros += static_cast<uint64_t>(result.fastMs * 1000.0);
+            
+            // Text post-processing would throw away is no better than none
+            if (result.fastConfidence >= m_cascade.minConfidence && !postProcessOCRText(fastText).empty()) {
+                result.accepted = true;
+                g_accepted++;
+                return fastText;
+            }
+            if (monitor && monitor->expired) {
+                return "";
+            }
+            result.escalated = true;
+            g_escalations++;
+            if (monitor) {
+                monitor->progressFirst = FAST_PASS_PROGRESS;
+                monitor->progressSpan = 100 - FAST_PASS_PROGRESS;
+            }
         }
         
-        // Clear Tesseract state before processing new image
-        m_tesseract->Clear();
-        
-        // Perform OCR
-        m_tesseract->SetImage(cleanedImage);
-        char* outText = m_tesseract->GetUTF8Text();
-        std::string extractedText = outText ? outText : "";
-        
-        // Clean up
-        delete[] outText;
-        pixDestroy(&cleanedImage);
-        
-        // Clear adaptive classifier to prevent memory buildup
-        m_tesseract->ClearAdaptiveClassifier();
-        
-        return postProcessText(extractedText);
+        auto fullStart = std::chrono::high_resolution_clock::now();
+        std::string extractedText = runRecognition(*m_tesseract, image, pageSegMode, nullptr, monitor);
+        result.fullMs = elapsedMs(fullStart);
+        if (result.escalated) {
+            g_fullMicros += static_cast<uint64_t>(result.fullMs * 1000.0);
+        }
+        return extractedText;
         
     } catch (const std::exception& e) {
         std::cerr << "Error processing image " << filename << ": " << e.what() << std::endl;
-        if (cleanedImage) {
-            pixDestroy(&cleanedImage);
-        }
         return "";
     }
 }
 
-Pix* OCRProcessor::cleanImage(const unsigned char* imageData, size_t dataSize) {
-    Pix* pix = pixReadMem(imageData, dataSize);
-    if (!pix) {
-        return nullptr;
+// Orientation and script detection is the most expensive part of a page
+// and mostly unnecessary after preprocessing, and LSTM recognition time
+// grows with the pixel count, so the fast pass skips the first and shrinks
+// the second
+std::string OCRProcessor::recognizeFast(Pix* image, tesseract::PageSegMode pageSegMode, int textHeight,
+                                        int& confidence, RecognitionMonitor* monitor) {
+    tesseract::TessBaseAPI& tesseract = m_fastTesseract ? *m_fastTesseract : *m_tesseract;
+    if (pageSegMode == tesseract::PSM_AUTO_OSD) {
+        pageSegMode = tesseract::PSM_AUTO;
     }
     
-    Pix* current = pix;
-    Pix* next = nullptr;
-    
-    // Convert to grayscale if needed
-    if (pixGetDepth(current) != 8) {
-        next = pixConvertTo8(current, 0);
-        if (!next) {
-            pixDestroy(&current);
-            return nullptr;
+    Pix* scaled = nullptr;
+    if (textHeight > 0) {
+        float scale = static_cast<float>(m_cascade.fastTextHeight) / textHeight;
+        if (scale < 0.9f) {
+            // Binary pages are only sampled by pixScale, which breaks up
+            // thin strokes; area-mapping them to gray keeps them
+            scaled = (pixGetDepth(image) == 1) ? pixScaleToGray(image, scale) : pixScale(image, scale, scale);
         }
-        pixDestroy(&current);
-        current = next;
     }
     
-    // Simple thresholding - most reliable approach
-    next = pixThresholdToBinary(current, 128);
-    if (next) {
-        pixDestroy(&current);
-        current = next;
+    std::string text = runRecognition(tesseract, scaled ? scaled : image, pageSegMode, &confidence, monitor);
+    if (scaled) {
+        pixDestroy(&scaled);
     }
-    
-    return current;
+    return text;
 }
 
-std::string OCRProcessor::postProcessText(const std::string& text) {
-    if (text.empty()) return "";
-    
-    std::string result = text;
-    
-    // Remove leading/trailing whitespace
-    size_t start = result.find_first_not_of(" \t\n\r\f\v");
-    if (start == std::string::npos) return "";
-    size_t end = result.find_last_not_of(" \t\n\r\f\v");
-    result = result.substr(start, end - start + 1);
-    
-    if (result.empty()) return "";
-    
-    // Common OCR error corrections with context awareness
-    std::vector<std::pair<std::string, std::string>> replacements = {
-        // Common character confusions
-        {"|", "l"}, {"[", "l"}, {"]", "l"}, {"\\", "l"}, {"//", "l"},
-        {"``", "\""}, {"''", "\""}, {"`", "'"}, {"´", "'"}, {"‘", "'"}, {"’", "'"},
-        {"“", "\""}, {"”", "\""}, {"„", "\""},
+std::string OCRProcessor::runRecognition(tesseract::TessBaseAPI& tesseract, Pix* image,
+                                         tesseract::PageSegMode pageSegMode, int* confidence,
+                                         RecognitionMonitor* monitor) {
+    // Clear Tesseract state before processing new image
+    tesseract.Clear();
+    
+    // Orientation and script detection and layout analysis are only
+    // worth their cost when preprocessing couldn't settle them. The
+    // engine was loaded from memory and can't run OSD itself.
+    Pix* upright = nullptr;
+    if (pageSegMode == tesseract::PSM_AUTO_OSD) {
+        pageSegMode = tesseract::PSM_AUTO;
+        if (m_osd) {
+            upright = m_osd->upright(image);
+        }
+    }
+    tesseract.SetPageSegMode(pageSegMode);
+    
+    // Perform OCR
+    tesseract.SetImage(upright ? upright : image);
+    std::string extractedText;
+    if (recognizeWithin(tesseract, monitor, true)) {
+        char* outText = tesseract.GetUTF8Text();
+        extractedText = outText ? outText : "";
         
-        // Number/letter confusions (context-dependent)
-        {"0", "O"},  // Zero to capital O
-        {"1", "l"},  // One to lowercase L
-        {"5", "S"},  // Five to capital S
-        {"8", "B"},  // Eight to capital B
-        {"6", "G"},  // Six to capital G
-        {"9", "g"},  // Nine to lowercase G
+        // Clean up
+        delete[] outText;
         
-        // Space and punctuation fixes
-        {" ,", ","}, {" .", "."}, {" ;", ";"}, {" :", ":"},
-        {"( ", "("}, {" )", ")"}, {"[ ", "["}, {" ]", "]"},
-        {"{ ", "{"}, {" }", "}"}, {" /", "/"}, {"\\ ", "\\"}
-    };
-    
-    // Apply basic replacements
-    for (const auto& replacement : replacements) {
-        size_t pos = 0;
-        while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
-            result.replace(pos, replacement.first.length(), replacement.second);
-            pos += replacement.second.length();
+        if (confidence) {
+            *confidence = tesseract.MeanTextConf();
         }
     }
     
-    // Advanced context-aware replacements
-    result = applyContextualReplacements(result);
-    
-    // Remove isolated punctuation at start/end
-    if (!result.empty()) {
-        std::string punctuation = ".,!?*-|`'\"";
-        while (!result.empty() && punctuation.find(result[0]) != std::string::npos) {
-            result.erase(0, 1);
-        }
-        while (!result.empty() && punctuation.find(result.back()) != std::string::npos) {
-            result.pop_back();
-        }
+    // Clear adaptive classifier to prevent memory buildup
+    tesseract.ClearAdaptiveClassifier();
+    if (upright) {
+        pixDestroy(&upright);
     }
     
-    // Remove multiple consecutive spaces
-    size_t pos = 0;
-    while ((pos = result.find("  ", pos)) != std::string::npos) {
-        result.replace(pos, 2, " ");
-        pos += 1;
+    return extractedText;
+}
+
+std::string OCRProcessor::recognizeWithConfidence(Pix* image, const std::string& filename,
+                                                  tesseract::PageSegMode pageSegMode, int& confidence,
+                                                  RecognitionMonitor* monitor) {
+    confidence = -1;
+    if (!m_initialized) {
+        std::cerr << "OCRProcessor not initialized for: " << filename << std::endl;
+        return "";
     }
     
-    // Final validation - if result looks like garbage, return empty
-    if (isLikelyGarbage(result)) {
+    try {
+        return runRecognition(*m_tesseract, image, pageSegMode, &confidence, monitor);
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing image " << filename << ": " << e.what() << std::endl;
         return "";
     }
-    
-    return result;
 }
 
-// New helper function for context-aware replacements
-std::string OCRProcessor::applyContextualReplacements(const std::string& text) {
-    if (text.length() <= 1) return text;
-    
-    std::string result = text;
+CascadeStats OCRProcessor::cascadeStats() {
+    CascadeStats stats{};
+    stats.fastPasses = g_fastPasses.load();
+    stats.accepted = g_accepted.load();
+    stats.escalations = g_escalations.load();
+    stats.fastMs = g_fastMicros.load() / 1000.0;
+    stats.fullMs = g_fullMicros.load() / 1000.0;
+    
+    // Every accepted fast pass saved one full pass; every fast pass,
+    // accepted, escalated or out of time, was extra work
+    if (stats.escalations > 0) {
+        double averageFullMs = stats.fullMs / stats.escalations;
+        stats.savedMs = stats.accepted * averageFullMs - stats.fastMs;
+    }
+    return stats;
+}
+
+void OCRProcessor::recordCascade(const CascadeResult& result) {
+    if (result.ranFastPass) {
+        g_fastPasses++;
+        g_fastMicros += static_cast<uint64_t>(result.fastMs * 1000.0);
+    }
+    if (result.accepted) {
+        g_accepted++;
+    }
+    if (result.escalated) {
+        g_escalations++;
+        g_fullMicros += static_cast<uint64_t>(result.fullMs * 1000.0);
+    }
+}
+
+std::vector<TextRegion> OCRProcessor::analyzeLayout(Pix* image, const std::string& filename) {
+    std::vector<TextRegion> regions;
+    if (!m_initialized) {
+        std::cerr << "OCRProcessor not initialized for: " << filename << std::endl;
+        return regions;
+    }
     
-    // Context-aware number/letter replacements
-    for (size_t i = 0; i < result.length(); ++i) {
-        char c = result[i];
+    try {
+        m_tesseract->Clear();
+        m_tesseract->SetPageSegMode(tesseract::PSM_AUTO);
+        m_tesseract->SetImage(image);
         
-        // Zero to O - usually at start of words or in all-caps contexts
-        if (c == '0' && (i == 0 || !std::isalnum(result[i-1]))) {
-            result[i] = 'O';
-        }
-        // One to l - usually in middle of words
-        else if (c == '1' && i > 0 && i < result.length()-1 && 
-                 std::isalpha(result[i-1]) && std::isalpha(result[i+1])) {
-            result[i] = 'l';
-        }
-        // Five to S - usually at start or middle of words
-        else if (c == '5' && i < result.length()-1 && std::isalpha(result[i+1])) {
-            result[i] = 'S';
+        // Blocks come back in Tesseract's reading order
+        Boxa* blocks = m_tesseract->GetComponentImages(tesseract::RIL_BLOCK, true, nullptr, nullptr);
+        if (blocks) {
+            l_int32 count = boxaGetCount(blocks);
+            for (l_int32 i = 0; i < count; ++i) {
+                TextRegion region;
+                boxaGetBoxGeometry(blocks, i, &region.x, &region.y, &region.width, &region.height);
+                regions.push_back(region);
+            }
+            boxaDestroy(&blocks);
         }
+        
+        m_tesseract->Clear();
+    } catch (const std::exception& e) {
+        std::cerr << "Error analyzing layout of " << filename << ": " << e.what() << std::endl;
+        regions.clear();
     }
     
-    // Fix common word patterns
-    std::vector<std::pair<std::string, std::string>> wordReplacements = {
-        {"lhe", "the"}, {"lhat", "that"}, {"lhis", "this"}, {"lhere", "there"},
-        {"wi1h", "with"}, {"1he", "the"}, {"0r", "Or"}, {"5tart", "Start"},
-        {"8ack", "Back"}, {"9ood", "good"}, {"6reat", "Great"}
-    };
+    return regions;
+}
+
+std::string OCRProcessor::recognizeRegion(Pix* image, const TextRegion& region, const std::string& filename,
+                                          RecognitionMonitor* monitor) {
+    if (!m_initialized) {
+        std::cerr << "OCRProcessor not initialized for: " << filename << std::endl;
+        return "";
+    }
     
-    for (const auto& replacement : wordReplacements) {
-        size_t pos = 0;
-        while ((pos = result.find(replacement.first, pos)) != std::string::npos) {
-            // Only replace if it's a whole word or at word boundaries
-            if ((pos == 0 || !std::isalnum(result[pos-1])) &&
-                (pos + replacement.first.length() >= result.length() || 
-                 !std::isalnum(result[pos + replacement.first.length()]))) {
-                result.replace(pos, replacement.first.length(), replacement.second);
-                pos += replacement.second.length();
-            } else {
-                pos += replacement.first.length();
-            }
+    try {
+        m_tesseract->Clear();
+        
+        // Layout has already been done for the whole page. Regions run side
+        // by side, so their callers count progress by finished regions.
+        m_tesseract->SetPageSegMode(tesseract::PSM_SINGLE_BLOCK);
+        m_tesseract->SetImage(image);
+        m_tesseract->SetRectangle(region.x, region.y, region.width, region.height);
+        
+        std::string extractedText;
+        if (recognizeWithin(*m_tesseract, monitor, false)) {
+            char* outText = m_tesseract->GetUTF8Text();
+            extractedText = outText ? outText : "";
+            delete[] outText;
         }
+        
+        m_tesseract->ClearAdaptiveClassifier();
+        
+        return extractedText;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing region of " << filename << ": " << e.what() << std::endl;
+        return "";
+    }
+}
+
+Pix* OCRProcessor::cleanImage(const unsigned char* imageData, size_t dataSize, const PreprocessOptions& options,
+                              PreprocessInfo& info, Pix** unprocessed) {
+    Pix* pix = readImage(imageData, dataSize, options);
+    if (!pix) {
+        return nullptr;
+    }
+    
+    // Blank pages and separator sheets never reach preprocessing or Tesseract
+    if (options.rejectBlank && looksBlank(pix)) {
+        info.noText = true;
+        pixDestroy(&pix);
+        return nullptr;
     }
     
-    return result;
+    if (unprocessed) {
+        *unprocessed = pixClone(pix);
+    }
+    return runPreprocessStages(pix, options, info);
 }
 
-// New function to detect likely garbage text
-bool OCRProcessor::isLikelyGarbage(const std::string& text) {
-    if (text.empty() || text.length() > 100) return false; // Too long might be real text
-    
-    int letterCount = 0;
-    int digitCount = 0;
-    int symbolCount = 0;
-    int consecutiveSymbols = 0;
-    int maxConsecutiveSymbols = 0;
-    
-    for (char c : text) {
-        if (std::isalpha(c)) {
-            letterCount++;
-            consecutiveSymbols = 0;
-        } else if (std::isdigit(c)) {
-            digitCount++;
-            consecutiveSymbols = 0;
-        } else if (!std::isspace(c)) {
-            symbolCount++;
-            consecutiveSymbols++;
-            maxConsecutiveSymbols = std::max(maxConsecutiveSymbols, consecutiveSymbols);
-        } else {
-            consecutiveSymbols = 0;
-        }
+// Text of any size leaves far more than this share of a page off the
+// background and on a sharp step between neighbouring pixels, while blank
+// scans, colored sheets and smooth photos leave next to none. A lone page
+// number is about the smallest thing that still passes.
+bool OCRProcessor::looksBlank(Pix* image) {
+    const int INK_CONTRAST = 64;
+    const float MIN_INK_FRACTION = 0.0002f;
+    const float MIN_EDGE_FRACTION = 0.0002f;
+    
+    InkStatistics ink;
+    if (!measureInk(image, INK_CONTRAST, ink)) {
+        return false;
+    }
+    return ink.inkFraction < MIN_INK_FRACTION || ink.edgeFraction < MIN_EDGE_FRACTION;
+}
+
+// Decodes the image, letting libjpeg drop resolution during the DCT when a
+// large JPEG would only be scaled down again by the scale stage
+Pix* OCRProcessor::readImage(const unsigned char* imageData, size_t dataSize, const PreprocessOptions& options) {
+    // Leptonica reads the first 12 bytes to tell the format
+    const size_t MIN_IMAGE_BYTES = 12;
+    if (dataSize < MIN_IMAGE_BYTES) {
+        return nullptr;
+    }
+    l_int32 format = IFF_UNKNOWN;
+    findFileFormatBuffer(imageData, &format);
+    if (format != IFF_JFIF_JPEG || !options.runs(PreprocessStage::Scale)) {
+        return pixReadMem(imageData, dataSize);
     }
     
-    // If mostly symbols or too many consecutive symbols, likely garbage
-    if (symbolCount > letterCount + digitCount) return true;
-    if (maxConsecutiveSymbols >= 3) return true;
+    // The header is read once, for the size the reduction is judged by
+    l_int32 width, height, spp, ycck, cmyk;
+    if (readHeaderMemJpeg(imageData, dataSize, &width, &height, &spp, &ycck, &cmyk) != 0) {
+        return pixReadMem(imageData, dataSize);
+    }
     
-    // If very short but has multiple different symbols, likely garbage
-    if (text.length() < 5 && symbolCount >= 2) return true;
+    int reduction = chooseJpegReduction(imageData, dataSize, width, height, options.targetTextHeight);
+    l_int32 warnings = 0;
+    Pix* pix = pixReadMemJpeg(imageData, dataSize, 0, reduction, &warnings, 0);
+    if (!pix) {
+        return pixReadMem(imageData, dataSize);
+    }
+    if (reduction == 1) {
+        return pix;
+    }
     
-    return false;
+    l_int32 xres = pixGetXRes(pix);
+    l_int32 yres = pixGetYRes(pix);
+    if (xres > 0 && yres > 0) {
+        pixSetResolution(pix, xres / reduction, yres / reduction);
+    }
+    
+    return pix;
+}
+
+// Picks the largest JPEG scale-down (1, 2, 4 or 8) that still leaves the
+// text at least targetTextHeight tall, judged from a 1/8 scale preview.
+// width and height are the full image's, from its header.
+int OCRProcessor::chooseJpegReduction(const unsigned char* imageData, size_t dataSize, l_int32 width, l_int32 height,
+                                      int targetTextHeight) {
+    // Below this the full decode is already cheap
+    const l_int32 MIN_PIXELS_TO_REDUCE = 4000000;
+    const int PREVIEW_REDUCTION = 8;
+    
+    if (static_cast<long long>(width) * height < MIN_PIXELS_TO_REDUCE || targetTextHeight <= 0) {
+        return 1;
+    }
+    
+    l_int32 warnings = 0;
+    Pix* preview = pixReadMemJpeg(imageData, dataSize, 0, PREVIEW_REDUCTION, &warnings, 0);
+    if (!preview) {
+        return 1;
+    }
+    int textHeight = estimateTextHeight(preview) * PREVIEW_REDUCTION;
+    pixDestroy(&preview);
+    
+    // Text too small to measure at 1/8 means the image needs every pixel
+    int reduction = 1;
+    if (textHeight > 0) {
+        while (reduction < PREVIEW_REDUCTION && textHeight / (reduction * 2) >= targetTextHeight) {
+            reduction *= 2;
+        }
+    }
+    return reduction;
+}
+
+// Corrections run as one pass of a compiled automaton; see TextCorrector
+std::string OCRProcessor::postProcessText(const std::string& text, const Lexicon* lexicon) {
+    return postProcessOCRText(text, lexicon);
 }
\ No newline at end of file
@@ -3,24 +3,191 @@
 
 #include <tesseract/baseapi.h>
 #include <leptonica/allheaders.h>
+#include "Preprocessor.h"
+#include "OCRProfile.h"
+#include "Lexicon.h"
+#include "TrainedData.h"
+#include "OrientationDetector.h"
 #include <string>
 #include <memory>
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// A block of text found by layout analysis, in image coordinates
+struct TextRegion {
+    int x, y, width, height;
+};
+
+// Watches the recognition of one image, across every pass over it (fast
+// and full, or all of its regions), through Tesseract's progress monitor.
+// Tesseract is cancelled between words once the deadline passes. Layout
+// analysis and OSD can't be interrupted, so an image can overrun by however
+// long those take.
+struct RecognitionMonitor {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::atomic<bool> expired{false};
+    
+    // Percentage of the image recognized so far, called on the recognizing
+    // thread between words, so it must be quick. Optional.
+    std::function<void(int percent)> onProgress;
+    
+    // Deadline timeoutMs from now; 0 leaves it unlimited
+    void start(int timeoutMs) {
+        if (timeoutMs > 0) {
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        }
+    }
+    
+    // Whether the deadline has passed; marks the monitor expired when it has
+    bool check() {
+        if (!expired && std::chrono::steady_clock::now() >= deadline) {
+            expired = true;
+        }
+        return expired;
+    }
+    
+    // Passes progress through scaled into [first, first + span), so several
+    // passes over one image count up once
+    void reportProgress(int passPercent) {
+        if (onProgress) {
+            onProgress(progressFirst + passPercent * progressSpan / 100);
+        }
+    }
+    int progressFirst = 0;
+    int progressSpan = 100;
+};
+
+// Whole pages are first recognized cheaply: without OSD, with the text
+// scaled down towards fastTextHeight, and with the fast model if one is
+// configured. The full configuration only runs when that pass is unsure.
+struct CascadeOptions {
+    bool enabled = true;
+    int minConfidence = 75;         // Mean word confidence (0-100) to accept the fast pass
+    int fastTextHeight = 18;        // Pixels; the fast pass never scales up
+    std::string fastModelPath;      // tessdata directory with a faster eng model,
+                                    // e.g. tessdata_fast; empty uses the main model
+    std::shared_ptr<const TrainedData> fastModel;   // fastModelPath's model, if loaded
+};
+
+// How the Tesseract engine is loaded. The engine mode and the dictionaries
+// (from the profile) are read while the model loads, so they can't change
+// after initialize(). LSTM only skips the legacy classifier, which is most
+// of each instance's memory.
+struct EngineOptions {
+    tesseract::OcrEngineMode engineMode = tesseract::OEM_LSTM_ONLY;
+    std::string tessdataPath;       // Directory with eng.traineddata, e.g. tessdata_fast;
+                                    // empty uses TESSDATA_PREFIX
+    std::shared_ptr<const TrainedData> model;   // tessdataPath's model loaded once for
+                                                // all processors; null reads the file
+    std::shared_ptr<OrientationDetector> osd;   // For PSM_AUTO_OSD, shared by all processors;
+                                                // null gives each processor its own
+};
+
+// Resident set size of the whole process, or 0 where it can't be read
+int64_t processResidentBytes();
+
+// How recognize() went for one image
+struct CascadeResult {
+    bool ranFastPass = false;
+    bool accepted = false;          // The fast pass's text was kept
+    bool escalated = false;
+    int fastConfidence = -1;
+    double fastMs = 0.0;
+    double fullMs = 0.0;
+};
+
+// Totals since startup, across all processors
+struct CascadeStats {
+    uint64_t fastPasses;            // Images that tried the fast pass
+    uint64_t accepted;              // ... and kept its text
+    uint64_t escalations;           // ... and then needed the full configuration
+    double fastMs;
+    double fullMs;
+    double savedMs;                 // Full passes avoided by accepted fast passes, at the
+                                    // average full-pass time, less all fast-pass time;
+                                    // 0 and meaningless until an escalation
+};
 
 class OCRProcessor {
 public:
     OCRProcessor();
     ~OCRProcessor();
     
+    // Without a profile the processor is set up for whole pages
     bool initialize();
+    bool initialize(const OCRProfile& profile, const CascadeOptions& cascade = CascadeOptions(),
+                    const EngineOptions& engine = EngineOptions());
+    const OCRProfile& profile() const { return *m_profile; }
+    double initMs() const { return m_initMs; }
+    
+    // Recognizes a small synthetic page with each of this processor's
+    // engines, so what Tesseract allocates and loads on first use is in
+    // place before a real image arrives. Returns how long it took.
+    double warmUp();
+    
+    // Preprocessing and segmentation mode for an image under a profile.
+    // Only whole-page profiles look for orientation, text areas and layout.
+    static PreprocessOptions preprocessOptionsFor(const OCRProfile& profile, PreprocessOptions options);
+    static tesseract::PageSegMode pageSegModeFor(const OCRProfile& profile, const PreprocessInfo& info);
     std::string processImage(const std::string& imageData, const std::string& filename);
     
+    // Individual pipeline stages. Only recognize() needs the Tesseract
+    // instance; decoding and post-processing can run on any thread.
+    // unprocessed, if given, is set to the image as decoded, before any
+    // preprocessing, for preprocessing it differently later. It is a clone,
+    // not a copy: preprocessing stages never modify their input.
+    static Pix* decodeImage(const std::string& imageData, const std::string& filename,
+                            const PreprocessOptions& options = PreprocessOptions(),
+                            PreprocessInfo* info = nullptr, Pix** unprocessed = nullptr);
+    // textHeight is the character height in image, if known, for the fast
+    // pass of the cascade. Without a monitor recognition runs to completion;
+    // with one, an image that runs out of time yields no text.
+    std::string recognize(Pix* image, const std::string& filename,
+                          tesseract::PageSegMode pageSegMode = tesseract::PSM_AUTO_OSD,
+                          int textHeight = 0, CascadeResult* cascade = nullptr, RecognitionMonitor* monitor = nullptr);
+    // The full configuration only, reporting Tesseract's mean word
+    // confidence (0-100) so results of different preprocessing can be ranked
+    std::string recognizeWithConfidence(Pix* image, const std::string& filename,
+                                        tesseract::PageSegMode pageSegMode, int& confidence,
+                                        RecognitionMonitor* monitor = nullptr);
+    static std::string postProcessText(const std::string& text, const Lexicon* lexicon = nullptr);
+    
+    // Page splitting for large images: analyzeLayout() finds the text blocks
+    // in reading order, then each block can be recognized on its own,
+    // possibly by different processors at the same time
+    std::vector<TextRegion> analyzeLayout(Pix* image, const std::string& filename);
+    std::string recognizeRegion(Pix* image, const TextRegion& region, const std::string& filename,
+                                RecognitionMonitor* monitor = nullptr);
+    
+    static CascadeStats cascadeStats();
+    // Adds a result to the totals, for images recognized by a processor in
+    // another process (WorkerProcess)
+    static void recordCascade(const CascadeResult& result);
+    
 private:
-    std::string postProcessText(const std::string& text);
-    std::string applyContextualReplacements(const std::string& text);
-    bool isLikelyGarbage(const std::string& text);
-    Pix* cleanImage(const unsigned char* imageData, size_t dataSize);
+    bool initializeEngine(tesseract::TessBaseAPI& tesseract, const TrainedData* model, const std::string& tessdataPath,
+                          tesseract::OcrEngineMode engineMode);
+    bool initializeFastModel();
+    std::string recognizeFast(Pix* image, tesseract::PageSegMode pageSegMode, int textHeight, int& confidence,
+                              RecognitionMonitor* monitor);
+    std::string runRecognition(tesseract::TessBaseAPI& tesseract, Pix* image, tesseract::PageSegMode pageSegMode,
+                               int* confidence, RecognitionMonitor* monitor);
+    static Pix* cleanImage(const unsigned char* imageData, size_t dataSize, const PreprocessOptions& options,
+                           PreprocessInfo& info, Pix** unprocessed);
+    static bool looksBlank(Pix* image);
+    static Pix* readImage(const unsigned char* imageData, size_t dataSize, const PreprocessOptions& options);
+    static int chooseJpegReduction(const unsigned char* imageData, size_t dataSize, l_int32 width, l_int32 height,
+                                   int targetTextHeight);
     
     std::unique_ptr<tesseract::TessBaseAPI> m_tesseract;
+    std::unique_ptr<tesseract::TessBaseAPI> m_fastTesseract;   // Only with CascadeOptions::fastModelPath
+    const OCRProfile* m_profile;
+    CascadeOptions m_cascade;
+    double m_initMs;
+    std::shared_ptr<OrientationDetector> m_osd;   // Null when OSD is never needed or unavailable
     bool m_initialized;
 };
 
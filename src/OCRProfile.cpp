@@ -0,0 +1,29 @@
+#include "OCRProfile.h"
+
+const std::vector<OCRProfile>& builtinProfiles() {
+    static const std::vector<OCRProfile> profiles = {
+        // Photos and scans of whole pages
+        {"page", tesseract::PSM_AUTO_OSD, true, false, "", true},
+        // A crop holding one line of text
+        {"line", tesseract::PSM_SINGLE_LINE, false, true, "", true},
+        // Word crops, as in the batch tool: no layout analysis at all
+        {"word", tesseract::PSM_SINGLE_WORD, false, true,
+         "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", false},
+        // Meter readings, amounts, codes
+        {"digits", tesseract::PSM_SINGLE_LINE, false, true, "0123456789.,-+/:", false},
+    };
+    return profiles;
+}
+
+const OCRProfile* findProfile(const std::string& name) {
+    const auto& profiles = builtinProfiles();
+    if (name.empty()) {
+        return &profiles.front();
+    }
+    for (const auto& profile : profiles) {
+        if (profile.name == name) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
\ No newline at end of file
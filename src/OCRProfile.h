@@ -0,0 +1,26 @@
+#ifndef OCRPROFILE_H
+#define OCRPROFILE_H
+
+#include <tesseract/baseapi.h>
+#include <string>
+#include <vector>
+
+// Recognition settings a client can pick per image. A processor is
+// initialized for one profile and keeps it, so serving a different profile
+// means using a different processor, never re-running Init.
+struct OCRProfile {
+    std::string name;
+    tesseract::PageSegMode pageSegMode;
+    bool wholePage;             // Preprocessing picks the segmentation mode per image
+    bool singleLine;            // Input is a crop of one line or word
+    std::string whitelist;      // Empty allows every character
+    bool dictionaries;          // Word lists help prose but hurt codes and numbers
+};
+
+// "page", "line", "word" and "digits"; page comes first and is the default
+const std::vector<OCRProfile>& builtinProfiles();
+
+// nullptr for unknown names; an empty name means the default profile
+const OCRProfile* findProfile(const std::string& name);
+
+#endif // OCRPROFILE_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "OCRServer.h"
 #include "OCRService.h"
+#include "PixMemoryPool.h"
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <csignal>
@@ -7,6 +8,15 @@
 #include <cstdlib>
 #include <thread>
 #include <chrono>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 std::atomic<bool> shutdownServer(false);
 
@@ -23,9 +33,19 @@ void segmentationHandler(int signal) {
     std::exit(1);
 }
 
-OCRServer::OCRServer(const std::string& address, size_t numThreads)
+static const char* engineModeName(tesseract::OcrEngineMode mode) {
+    switch (mode) {
+        case tesseract::OEM_TESSERACT_ONLY: return "legacy";
+        case tesseract::OEM_LSTM_ONLY: return "lstm";
+        case tesseract::OEM_TESSERACT_LSTM_COMBINED: return "combined";
+        default: return "default";
+    }
+}
+
+OCRServer::OCRServer(const std::string& address, const PipelineConfig& pipelineConfig, bool zygote)
     : m_address(address)
-    , m_numThreads(numThreads) {
+    , m_pipelineConfig(pipelineConfig)
+    , m_zygote(zygote) {
 }
 
 OCRServer::~OCRServer() {
@@ -33,46 +53,20 @@ OCRServer::~OCRServer() {
 }
 
 void OCRServer::run() {
+#ifndef _WIN32
+    if (m_zygote) {
+        runZygote();
+        return;
+    }
+#endif
     int restartCount = 0;
-    const int MAX_RESTARTS = 3;
     
     while (restartCount < MAX_RESTARTS) {
         try {
             std::cout << "Starting OCR Server (attempt " << (restartCount + 1) << ")..." << std::endl;
             
-            OCRServiceImpl service(m_numThreads);
-            
-            grpc::ServerBuilder builder;
-            builder.AddListeningPort(m_address, grpc::InsecureServerCredentials());
-            builder.RegisterService(&service);
-            
-            // Set max message size to handle large images
-            builder.SetMaxMessageSize(100 * 1024 * 1024); // 100MB
-            builder.SetMaxReceiveMessageSize(100 * 1024 * 1024); // 100MB
-            
-            m_server = builder.BuildAndStart();
-            if (!m_server) {
-                throw std::runtime_error("Failed to build and start server");
-            }
-            
-            std::cout << "OCR Server listening on " << m_address << std::endl;
-            std::cout << "Using " << m_numThreads << " worker threads" << std::endl;
-            std::cout << "Press Ctrl+C to stop the server..." << std::endl;
-            
-            // Set up signal handling
-            std::signal(SIGINT, signalHandler);
-            std::signal(SIGTERM, signalHandler);
-            std::signal(SIGSEGV, segmentationHandler);
-            
-            // Reset restart count on successful start
-            restartCount = 0;
-            
-            // Wait for shutdown signal
-            while (!shutdownServer) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            }
-            
-            shutdown();
+            OCRServiceImpl service(m_pipelineConfig);
+            serve(service);
             break;
             
         } catch (const std::exception& e) {
@@ -91,6 +85,257 @@ void OCRServer::run() {
     }
 }
 
+// Serves until a shutdown signal arrives
+void OCRServer::serve(OCRServiceImpl& service) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(m_address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+    
+    // Set max message size to handle large images
+    builder.SetMaxMessageSize(100 * 1024 * 1024); // 100MB
+    builder.SetMaxReceiveMessageSize(100 * 1024 * 1024); // 100MB
+    // A zygote starts each replacement server while the old one still
+    // listens on the same port
+    if (m_zygote) {
+        builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 1);
+    }
+    
+    m_server = builder.BuildAndStart();
+    if (!m_server) {
+        throw std::runtime_error("Failed to build and start server");
+    }
+#ifndef _WIN32
+    if (m_readyFd >= 0) {
+        char listening = 1;
+        while (write(m_readyFd, &listening, 1) < 0 && errno == EINTR) {
+        }
+        close(m_readyFd);
+        m_readyFd = -1;
+    }
+#endif
+    
+    std::cout << "OCR Server listening on " << m_address << std::endl;
+    std::cout << "Using " << m_pipelineConfig.recognizeThreads << " recognizer threads" << std::endl;
+    if (m_pipelineConfig.workerProcesses) {
+        std::cout << "Recognizing in worker processes, one per processor" << std::endl;
+    }
+    std::cout << "Preprocessing: " << preprocessStagesName(m_pipelineConfig.preprocess.stages) << std::endl;
+    std::cout << "Engine: " << engineModeName(m_pipelineConfig.engine.engineMode) << " ("
+              << (m_pipelineConfig.engine.tessdataPath.empty() ? "default tessdata"
+                                                               : m_pipelineConfig.engine.tessdataPath)
+              << ")" << std::endl;
+    if (m_pipelineConfig.cascade.enabled) {
+        std::cout << "Recognition cascade: fast pass accepted at confidence "
+                  << m_pipelineConfig.cascade.minConfidence << " ("
+                  << (m_pipelineConfig.cascade.fastModelPath.empty() ? "main model"
+                                                                     : m_pipelineConfig.cascade.fastModelPath)
+                  << ")" << std::endl;
+    }
+    if (m_pipelineConfig.imageTimeoutMs > 0) {
+        std::cout << "Recognition time limit: " << m_pipelineConfig.imageTimeoutMs / 1000.0 << "s per image"
+                  << std::endl;
+    }
+    std::cout << "Press Ctrl+C to stop the server..." << std::endl;
+    
+    // Set up signal handling
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+    std::signal(SIGSEGV, segmentationHandler);
+    
+    // Wait for shutdown signal
+    while (!shutdownServer) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    
+    shutdown();
+}
+
+#ifndef _WIN32
+// Only touched by the zygote, whose single thread forks the servers
+static volatile sig_atomic_t serverProcess = 0;
+static volatile sig_atomic_t startingProcess = 0;      // A replacement not yet listening
+
+static void zygoteSignalHandler(int signal) {
+    shutdownServer = true;
+    if (serverProcess > 0) {
+        kill(serverProcess, signal);
+    }
+    if (startingProcess > 0) {
+        kill(startingProcess, signal);
+    }
+}
+
+static void reap(pid_t child, int* status) {
+    while (waitpid(child, status, 0) < 0 && errno == EINTR) {
+    }
+}
+
+// How long a server forked by the zygote runs before a fresh fork replaces
+// it, when processors are recycled
+static const auto SERVER_RECYCLE_INTERVAL = std::chrono::minutes(10);
+
+// Forks a server from prepared and waits until it is listening, or has
+// failed to. Returns its pid, or -1 if fork() failed.
+int OCRServer::forkServer(PreparedProcessors& prepared, bool& listening) {
+    listening = false;
+    int ready[2];
+    if (pipe(ready) != 0) {
+        std::cerr << "Cannot create a pipe for the server process: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    // Anything still buffered would otherwise be written by both processes
+    std::cout.flush();
+    std::cerr.flush();
+    
+    pid_t child = fork();
+    if (child == 0) {
+        close(ready[0]);
+        m_readyFd = ready[1];
+        int status = 0;
+        try {
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            // The zygote recycles by forking a whole new server instead
+            PipelineConfig serverConfig = m_pipelineConfig;
+            serverConfig.recycleProcessors = false;
+            OCRServiceImpl service(serverConfig, std::move(prepared));
+            serve(service);
+        } catch (const std::exception& e) {
+            std::cerr << "Server error: " << e.what() << std::endl;
+            status = 1;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        // The zygote's exit handlers and static destructors are its own
+        _exit(status);
+    }
+    close(ready[1]);
+    if (child < 0) {
+        std::cerr << "Cannot fork the server process: " << std::strerror(errno) << std::endl;
+        close(ready[0]);
+        return -1;
+    }
+    
+    // The pipe closes without a byte if the server fails to start
+    startingProcess = child;
+    char byte = 0;
+    ssize_t received;
+    while ((received = read(ready[0], &byte, 1)) < 0 && errno == EINTR) {
+    }
+    close(ready[0]);
+    startingProcess = 0;
+    listening = received == 1;
+    return child;
+}
+
+// This process becomes the zygote: it initializes and warms up every
+// processor once, while it has no other threads, and then forks the actual
+// server. The server starts with the processors ready and shares their
+// pages with the zygote until it writes to them, so a server that crashes
+// is replaced by another fork in milliseconds instead of reinitializing.
+// Servers never recycle single processors, since a fresh instance would
+// share nothing with the zygote; with recycleProcessors the zygote instead
+// replaces the whole server every SERVER_RECYCLE_INTERVAL, starting the new
+// one before the old one drains its streams and exits.
+// Nothing that starts threads (gRPC, the pipeline's stages) may run here
+// before fork().
+void OCRServer::runZygote() {
+    PreparedProcessors prepared;
+    try {
+        PipelineConfig zygoteConfig = m_pipelineConfig;
+        zygoteConfig.warmUp = false;
+        prepared = OCRPipeline::prepareProcessors(zygoteConfig);
+        
+        // Warmed up here, what warming up allocates is shared by every
+        // server rather than written into each one's own copy. Tesseract
+        // built with OpenMP would start a thread pool, which doesn't survive
+        // fork(), so this thread is limited to one OpenMP thread, which
+        // starts none. The limit is this thread's own: the servers'
+        // recognize threads keep the default.
+        if (m_pipelineConfig.warmUp) {
+            using SetThreads = void (*)(int);
+            auto setOpenMPThreads = reinterpret_cast<SetThreads>(dlsym(RTLD_DEFAULT, "omp_set_num_threads"));
+            if (setOpenMPThreads) {
+                setOpenMPThreads(1);
+            }
+            OCRPipeline::warmUpProcessors(prepared);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Server error: " << e.what() << std::endl;
+        return;
+    }
+    
+    std::signal(SIGINT, zygoteSignalHandler);
+    std::signal(SIGTERM, zygoteSignalHandler);
+    
+    // Crashes closer together than this count towards MAX_RESTARTS
+    const auto STABLE_UPTIME = std::chrono::seconds(60);
+    int restartCount = 0;
+    
+    while (!shutdownServer && restartCount < MAX_RESTARTS) {
+        std::cout << "Starting OCR Server (attempt " << (restartCount + 1) << ") from the zygote..." << std::endl;
+        
+        auto started = std::chrono::steady_clock::now();
+        bool listening = false;
+        pid_t child = forkServer(prepared, listening);
+        if (child < 0) {
+            return;
+        }
+        serverProcess = child;
+        
+        auto recycleAt = started + SERVER_RECYCLE_INTERVAL;
+        int status = 0;
+        while (true) {
+            pid_t exited = waitpid(child, &status, WNOHANG);
+            if (exited == child || (exited < 0 && errno != EINTR)) {
+                break;
+            }
+            if (m_pipelineConfig.recycleProcessors && listening && !shutdownServer &&
+                std::chrono::steady_clock::now() >= recycleAt) {
+                bool replacementListening = false;
+                pid_t replacement = forkServer(prepared, replacementListening);
+                if (replacement > 0 && replacementListening && !shutdownServer) {
+                    // The old server stops accepting and finishes its streams
+                    serverProcess = replacement;
+                    kill(child, SIGTERM);
+                    reap(child, nullptr);
+                    std::cout << "Replaced server process " << child << " with " << replacement << std::endl;
+                    child = replacement;
+                    started = std::chrono::steady_clock::now();
+                } else if (replacement > 0) {
+                    if (!shutdownServer) {
+                        std::cerr << "Replacement server process " << replacement << " failed to start, keeping "
+                                  << child << std::endl;
+                    }
+                    kill(replacement, SIGKILL);
+                    reap(replacement, nullptr);
+                }
+                recycleAt = std::chrono::steady_clock::now() + SERVER_RECYCLE_INTERVAL;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        serverProcess = 0;
+        
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            break;
+        }
+        if (WIFSIGNALED(status)) {
+            std::cerr << "Server process " << child << " was killed by signal " << WTERMSIG(status) << std::endl;
+        } else {
+            std::cerr << "Server process " << child << " exited with status " << WEXITSTATUS(status) << std::endl;
+        }
+        
+        if (std::chrono::steady_clock::now() - started >= STABLE_UPTIME) {
+            restartCount = 0;
+        }
+        restartCount++;
+        if (restartCount >= MAX_RESTARTS) {
+            std::cerr << "Maximum restart attempts reached. Server will not restart." << std::endl;
+        }
+    }
+}
+#endif
+
 void OCRServer::shutdown() {
     if (m_server) {
         std::cout << "Shutting down server gracefully..." << std::endl;
@@ -103,7 +348,13 @@ void OCRServer::shutdown() {
 // MAIN FUNCTION MUST BE PRESENT
 int main(int argc, char* argv[]) {
     std::string address = "0.0.0.0:50051";
-    size_t numThreads = 4;
+    PipelineConfig pipelineConfig;
+    bool zygote = false;            // Fork servers from one initialized process (POSIX only)
+    
+    // This executable is also the OCR worker (WorkerProcess::start)
+    if (argc == 5 && std::string(argv[1]) == "--ocr-worker") {
+        return WorkerProcess::serve(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
+    }
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -120,17 +371,137 @@ int main(int argc, char* argv[]) {
                 address = "0.0.0.0:" + port;
             }
         } else if (arg == "--threads" && i + 1 < argc) {
-            numThreads = std::stoul(argv[++i]);
+            pipelineConfig.recognizeThreads = std::stoul(argv[++i]);
+        } else if (arg == "--decode-threads" && i + 1 < argc) {
+            pipelineConfig.decodeThreads = std::stoul(argv[++i]);
+        } else if (arg == "--output-threads" && i + 1 < argc) {
+            pipelineConfig.outputThreads = std::stoul(argv[++i]);
+        } else if (arg == "--queue-depth" && i + 1 < argc) {
+            pipelineConfig.queueDepth = std::stoul(argv[++i]);
+        } else if (arg == "--max-in-flight" && i + 1 < argc) {
+            pipelineConfig.maxInFlight = std::stoul(argv[++i]);
+        } else if (arg == "--binarization" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            pipelineConfig.preprocess.binarization = parseBinarizationMode(mode);
+            if (pipelineConfig.preprocess.binarization == BinarizationMode::Default) {
+                std::cerr << "Unknown binarization mode: " << mode << " (expected global, otsu or sauvola)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-rescale") {
+            pipelineConfig.preprocess.rescale = false;
+        } else if (arg == "--text-height" && i + 1 < argc) {
+            pipelineConfig.preprocess.targetTextHeight = std::stoi(argv[++i]);
+        } else if (arg == "--region-split-mp" && i + 1 < argc) {
+            pipelineConfig.regionSplitPixels = static_cast<size_t>(std::stod(argv[++i]) * 1000000);
+        } else if (arg == "--no-crop") {
+            pipelineConfig.preprocess.cropToText = false;
+        } else if (arg == "--profile-processors" && i + 1 < argc) {
+            // NAME=COUNT, e.g. word=4; a count of 0 disables the profile,
+            // except for page, which everything else falls back to
+            std::string setting = argv[++i];
+            size_t equals = setting.find('=');
+            std::string name = setting.substr(0, equals);
+            if (equals == std::string::npos || !findProfile(name)) {
+                std::cerr << "Invalid --profile-processors value: " << setting << std::endl;
+                return 1;
+            }
+            size_t count = std::stoul(setting.substr(equals + 1));
+            if (name == findProfile("")->name) {
+                if (count == 0) {
+                    std::cerr << "Invalid --profile-processors value: " << setting
+                              << " (the " << name << " profile needs at least one processor)" << std::endl;
+                    return 1;
+                }
+                pipelineConfig.recognizeThreads = count;
+            } else {
+                pipelineConfig.profileProcessors[name] = count;
+            }
+        } else if (arg == "--preprocess" && i + 1 < argc) {
+            std::string spec = argv[++i];
+            if (!parsePreprocessStages(spec, pipelineConfig.preprocess.stages)) {
+                std::cerr << "Invalid --preprocess stages: " << spec
+                          << " (expected a comma-separated list of convert, denoise, normalize,"
+                          << " binarize, scale, deskew, crop, invert)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--lexicon" && i + 1 < argc) {
+            pipelineConfig.lexiconPath = argv[++i];
+        } else if (arg == "--build-lexicon" && i + 2 < argc) {
+            // Compiles a word list for --lexicon and exits
+            std::string wordList = argv[++i];
+            std::string output = argv[++i];
+            return Lexicon::buildFromWordList(wordList, output) ? 0 : 1;
+        } else if (arg == "--engine" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "lstm") {
+                pipelineConfig.engine.engineMode = tesseract::OEM_LSTM_ONLY;
+            } else if (mode == "legacy") {
+                pipelineConfig.engine.engineMode = tesseract::OEM_TESSERACT_ONLY;
+            } else if (mode == "combined") {
+                pipelineConfig.engine.engineMode = tesseract::OEM_TESSERACT_LSTM_COMBINED;
+            } else {
+                std::cerr << "Unknown engine mode: " << mode << " (expected lstm, legacy or combined)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--tessdata" && i + 1 < argc) {
+            pipelineConfig.engine.tessdataPath = argv[++i];
+        } else if (arg == "--no-cascade") {
+            pipelineConfig.cascade.enabled = false;
+        } else if (arg == "--cascade-confidence" && i + 1 < argc) {
+            pipelineConfig.cascade.minConfidence = std::stoi(argv[++i]);
+        } else if (arg == "--fast-tessdata" && i + 1 < argc) {
+            pipelineConfig.cascade.fastModelPath = argv[++i];
+        } else if (arg == "--image-timeout" && i + 1 < argc) {
+            pipelineConfig.imageTimeoutMs = static_cast<int>(std::stod(argv[++i]) * 1000);
+        } else if (arg == "--no-warm-up") {
+            pipelineConfig.warmUp = false;
+        } else if (arg == "--no-reject-blank") {
+            pipelineConfig.preprocess.rejectBlank = false;
+        } else if (arg == "--no-retry") {
+            pipelineConfig.retryEmpty = false;
+        } else if (arg == "--always-osd") {
+            pipelineConfig.preprocess.fastOrientation = false;
+        } else if (arg == "--zygote") {
+#ifdef _WIN32
+            std::cerr << "--zygote needs fork(), ignoring it on Windows" << std::endl;
+#else
+            zygote = true;
+#endif
+        } else if (arg == "--worker-processes") {
+#ifdef _WIN32
+            std::cerr << "--worker-processes needs fork(), ignoring it on Windows" << std::endl;
+#else
+            pipelineConfig.workerProcesses = true;
+#endif
         } else if (arg == "--help") {
-            std::cout << "Usage: " << argv[0] << " [--address IP] [--port PORT] [--threads NUM_THREADS]" << std::endl;
+            std::cout << "Usage: " << argv[0] << " [--address IP] [--port PORT] [--threads NUM_THREADS]"
+                      << " [--decode-threads N] [--output-threads N] [--queue-depth N] [--max-in-flight N]"
+                      << " [--binarization global|otsu|sauvola] [--no-rescale] [--text-height PIXELS]"
+                      << " [--always-osd] [--region-split-mp MEGAPIXELS] [--no-crop] [--no-reject-blank]"
+                      << " [--profile-processors page|line|word|digits=N] [--preprocess STAGE,STAGE,...]"
+                      << " [--lexicon FILE] [--build-lexicon WORDLIST FILE]"
+                      << " [--engine lstm|legacy|combined] [--tessdata DIR]"
+                      << " [--no-cascade] [--cascade-confidence 0-100] [--fast-tessdata DIR] [--no-retry]"
+                      << " [--image-timeout SECONDS] [--no-warm-up] [--zygote] [--worker-processes]" << std::endl;
             std::cout << "Examples:" << std::endl;
             std::cout << "  " << argv[0] << " --address 192.168.1.100 --port 50051" << std::endl;
             std::cout << "  " << argv[0] << " --port 8080 --threads 8" << std::endl;
+            std::cout << "  " << argv[0] << " --build-lexicon eng.wordlist eng.lex" << std::endl;
             return 0;
         }
     }
     
-    OCRServer server(address, numThreads);
+    // Workers already isolate Tesseract from the server; a zygote would
+    // only hold processors nothing uses
+    if (zygote && pipelineConfig.workerProcesses) {
+        std::cerr << "--zygote has no effect with --worker-processes, ignoring it" << std::endl;
+        zygote = false;
+    }
+    
+    // Before any image is decoded, so every Pix buffer comes from the pool
+    PixMemoryPool::install();
+    
+    OCRServer server(address, pipelineConfig, zygote);
     server.run();
     
     return 0;
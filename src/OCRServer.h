@@ -4,17 +4,34 @@
 #include <string>
 #include <memory>
 #include <grpcpp/grpcpp.h>  
+#include "OCRPipeline.h"
+
+class OCRServiceImpl;
+
 class OCRServer {
 public:
-    OCRServer(const std::string& address = "0.0.0.0:50051", size_t numThreads = 4);
+    // With zygote, the processors are initialized once in this process and
+    // every (re)start forks a server process from it. Ignored on Windows.
+    OCRServer(const std::string& address = "0.0.0.0:50051", const PipelineConfig& pipelineConfig = PipelineConfig(),
+              bool zygote = false);
     ~OCRServer();
     
     void run();
     void shutdown();
 
 private:
+    static const int MAX_RESTARTS = 3;
+    
+    void serve(OCRServiceImpl& service);
+#ifndef _WIN32
+    void runZygote();
+    int forkServer(PreparedProcessors& prepared, bool& listening);
+#endif
+    
     std::string m_address;
-    size_t m_numThreads;
+    PipelineConfig m_pipelineConfig;
+    bool m_zygote;
+    int m_readyFd = -1;     // Written to once listening, in a server forked by the zygote
     std::unique_ptr<grpc::Server> m_server;
 };
 
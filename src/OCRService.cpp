@@ -1,171 +1,457 @@
 #include "OCRService.h"
+#include "PixMemoryPool.h"
 #include <iostream>
 #include <mutex>
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <sstream>
 
 // Global memory monitoring
 std::atomic<size_t> g_activeImageSize{0};
 const size_t MAX_MEMORY_USAGE = 500 * 1024 * 1024; // 500MB limit
 
-OCRServiceImpl::OCRServiceImpl(size_t numThreads) 
-    : m_threadPool(numThreads)
-    , m_nextProcessorIndex(0)
-    , m_cleanupRunning(true)
-{
-    for (size_t i = 0; i < numThreads; ++i) {
-        auto processor = std::make_unique<OCRProcessor>();
-        if (processor->initialize()) {
-            m_processors.push_back(std::move(processor));
-        }
+static BinarizationMode toBinarizationMode(ocr::Binarization binarization) {
+    switch (binarization) {
+        case ocr::BINARIZATION_GLOBAL: return BinarizationMode::Global;
+        case ocr::BINARIZATION_OTSU: return BinarizationMode::Otsu;
+        case ocr::BINARIZATION_SAUVOLA: return BinarizationMode::Sauvola;
+        default: return BinarizationMode::Default;
     }
-    
-    if (m_processors.empty()) {
-        throw std::runtime_error("Failed to initialize any OCR processors");
+}
+
+// Interim progress for an image starts after PROGRESS_DELAY, so quick images
+// never send any, and then comes at most once per PROGRESS_INTERVAL. It is
+// dropped while a slow client has MAX_QUEUED_WRITES messages unsent.
+static const std::chrono::milliseconds PROGRESS_DELAY(1000);
+static const std::chrono::milliseconds PROGRESS_INTERVAL(500);
+static const size_t MAX_QUEUED_WRITES = 64;
+
+static ocr::ProgressStage toProgressStage(JobStage stage) {
+    switch (stage) {
+        case JobStage::Preprocessing: return ocr::PROGRESS_PREPROCESSING;
+        case JobStage::Recognizing: return ocr::PROGRESS_RECOGNIZING;
+        case JobStage::Retrying: return ocr::PROGRESS_RETRYING;
+        case JobStage::PostProcessing: return ocr::PROGRESS_POSTPROCESSING;
     }
-    
-    // Start memory cleanup thread
-    m_cleanupThread = std::thread(&OCRServiceImpl::memoryCleanupTask, this);
-    
-    std::cout << "OCR Service initialized with " << m_processors.size() << " processors" << std::endl;
+    return ocr::PROGRESS_UNSPECIFIED;
 }
 
-OCRServiceImpl::~OCRServiceImpl() {
-    m_cleanupRunning = false;
-    if (m_cleanupThread.joinable()) {
-        m_cleanupThread.join();
+// "scale 3.1ms, binarize 5.0ms, " for the per-image log line
+static std::string formatStageTimings(const PreprocessInfo& info) {
+    std::ostringstream out;
+    out.precision(2);
+    out << std::fixed;
+    for (const auto& timing : info.stageTimings) {
+        out << preprocessStageName(timing.stage) << " " << timing.ms << "ms, ";
     }
-    
-    m_threadPool.waitAll();
+    return out.str();
 }
 
-void OCRServiceImpl::memoryCleanupTask() {
-    while (m_cleanupRunning) {
-        std::this_thread::sleep_for(std::chrono::seconds(30)); // Cleanup every 30 seconds
-        
-        // Force cleanup by recreating processors periodically
-        std::cout << "Performing memory cleanup..." << std::endl;
+// Drives one client stream as coroutines: read -> admit -> decode ->
+// recognize -> write. Each of those steps is awaited, so a stream with
+// thousands of pending images holds no threads while they wait.
+class OCRStreamReactor : public grpc::ServerBidiReactor<ocr::ImageRequest, ocr::OCRResult> {
+public:
+    explicit OCRStreamReactor(OCRPipeline& pipeline)
+        : m_pipeline(pipeline)
+        , m_pending(0) {
+        std::cout << "Client connected" << std::endl;
+        readLoop();
+    }
+    
+    void OnReadDone(bool ok) override {
+        // Resume inline: the loop only does bookkeeping before it suspends again
+        m_readOk = ok;
+        m_readWaiter.resume();
+    }
+    
+    void OnWriteDone(bool ok) override {
+        PendingWrite done;
+        const ocr::OCRResult* next = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            done = std::move(m_writeQueue.front());
+            m_writeQueue.pop_front();
+            if (!m_writeQueue.empty()) {
+                next = &m_writeQueue.front().result;
+            } else {
+                m_writing = false;
+            }
+        }
         
-        for (auto& processor : m_processors) {
-            // Recreate processor to clear Tesseract memory
-            processor = std::make_unique<OCRProcessor>();
-            processor->initialize();
+        // Only one write may be outstanding on a stream
+        if (next) {
+            StartWrite(next);
         }
         
-        std::cout << "Memory cleanup completed" << std::endl;
+        // Interim messages have nobody waiting for them
+        if (done.waiter) {
+            *done.ok = ok;
+            done.waiter.resume();
+        }
     }
-}
-
-grpc::Status OCRServiceImpl::ProcessImages(
-    grpc::ServerContext* context,
-    grpc::ServerReaderWriter<ocr::OCRResult, ocr::ImageRequest>* stream) {
     
-    std::cout << "Client connected" << std::endl;
+    void OnDone() override {
+        std::cout << "Client disconnected. Final memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
+        delete this;
+    }
     
-    // Add semaphore to limit concurrent processing
-    std::atomic<int> activeTasks{0};
-    const int MAX_CONCURRENT_TASKS = 4; // Reduced from 8 to 4
+private:
+    struct PendingWrite {
+        ocr::OCRResult result;
+        std::coroutine_handle<> waiter;
+        bool* ok = nullptr;
+    };
     
-    ocr::ImageRequest request;
-    while (stream->Read(&request)) {
-        std::string imageId = request.image_id();
-        std::string filename = request.filename();
-        std::string imageData = request.image_data();
+    // co_await read() yields false once the client is done sending
+    auto read() {
+        struct Awaiter {
+            OCRStreamReactor& reactor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                reactor.m_readWaiter = handle;
+                reactor.StartRead(&reactor.m_request);
+            }
+            bool await_resume() const noexcept { return reactor.m_readOk; }
+        };
+        return Awaiter{*this};
+    }
+    
+    // co_await write(result) yields whether the result reached the stream
+    auto write(ocr::OCRResult result) {
+        struct Awaiter {
+            OCRStreamReactor& reactor;
+            ocr::OCRResult result;
+            bool ok = false;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                const ocr::OCRResult* start = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(reactor.m_writeMutex);
+                    reactor.m_writeQueue.push_back(PendingWrite{std::move(result), handle, &ok});
+                    if (!reactor.m_writing) {
+                        reactor.m_writing = true;
+                        start = &reactor.m_writeQueue.back().result;
+                    }
+                }
+                if (start) {
+                    reactor.StartWrite(start);
+                }
+            }
+            bool await_resume() const noexcept { return ok; }
+        };
+        return Awaiter{*this, std::move(result)};
+    }
+    
+    // Queues a message nobody waits for. Called from pipeline threads, but
+    // only while the image it is about is pending, so before Finish().
+    void sendInterim(ocr::OCRResult result) {
+        const ocr::OCRResult* start = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            if (m_writeQueue.size() >= MAX_QUEUED_WRITES) {
+                return;
+            }
+            m_writeQueue.push_back(PendingWrite{std::move(result), nullptr, nullptr});
+            if (!m_writing) {
+                m_writing = true;
+                start = &m_writeQueue.back().result;
+            }
+        }
+        if (start) {
+            StartWrite(start);
+        }
+    }
+    
+    std::function<void(JobStage, int)> progressReporter(const std::string& imageId);
+    
+    // co_await drained() resumes once every admitted image has been answered
+    auto drained() {
+        struct Awaiter {
+            OCRStreamReactor& reactor;
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> lock(reactor.m_pendingMutex);
+                if (reactor.m_pending == 0) {
+                    return false;
+                }
+                reactor.m_drainWaiter = handle;
+                return true;
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+    
+    DetachedTask readLoop();
+    DetachedTask handleImage(std::shared_ptr<OCRJob> job, size_t imageSize);
+    
+    OCRPipeline& m_pipeline;
+    
+    ocr::ImageRequest m_request;
+    std::coroutine_handle<> m_readWaiter;
+    bool m_readOk = false;
+    
+    std::mutex m_writeMutex;
+    std::deque<PendingWrite> m_writeQueue;
+    bool m_writing = false;
+    
+    std::mutex m_pendingMutex;
+    int m_pending;
+    std::coroutine_handle<> m_drainWaiter;
+};
+
+std::function<void(JobStage, int)> OCRStreamReactor::progressReporter(const std::string& imageId) {
+    struct Throttle {
+        std::mutex mutex;
+        std::chrono::steady_clock::time_point next;
+        JobStage stage = JobStage::Preprocessing;
+        int percent = -1;
+    };
+    auto throttle = std::make_shared<Throttle>();
+    throttle->next = std::chrono::steady_clock::now() + PROGRESS_DELAY;
+    
+    return [this, imageId, throttle](JobStage stage, int percent) {
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(throttle->mutex);
+            if (now < throttle->next || (stage == throttle->stage && percent == throttle->percent)) {
+                return;
+            }
+            throttle->next = now + PROGRESS_INTERVAL;
+            throttle->stage = stage;
+            throttle->percent = percent;
+        }
+        
+        ocr::OCRResult result;
+        result.set_image_id(imageId);
+        result.mutable_progress()->set_stage(toProgressStage(stage));
+        result.mutable_progress()->set_percent(percent);
+        sendInterim(std::move(result));
+    };
+}
+
+DetachedTask OCRStreamReactor::readLoop() {
+    while (co_await read()) {
+        std::string imageId = m_request.image_id();
+        std::string filename = m_request.filename();
         
         // Memory usage monitoring
-        size_t currentMemory = g_activeImageSize.load() + imageData.size();
+        size_t imageSize = m_request.image_data().size();
+        size_t currentMemory = g_activeImageSize.load() + imageSize;
         if (currentMemory > MAX_MEMORY_USAGE) {
             std::cerr << "Memory limit exceeded. Rejecting image: " << filename << std::endl;
             
             ocr::OCRResult result;
             result.set_image_id(imageId);
             result.set_success(false);
+            result.set_status(ocr::STATUS_FAILED);
             result.set_error_message("Server memory limit exceeded");
             
-            std::lock_guard<std::mutex> lock(m_streamMutex);
-            stream->Write(result);
+            co_await write(std::move(result));
             continue;
         }
         
-        std::cout << "Processing image: " << filename 
-                  << " Size: " << imageData.size() << " bytes" 
-                  << " Active tasks: " << activeTasks.load()
-                  << " Total memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
-        
-        // Rate limiting: wait if too many concurrent tasks
-        while (activeTasks.load() >= MAX_CONCURRENT_TASKS) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
-        
         // Validate image data
-        if (imageData.empty()) {
+        if (imageSize == 0) {
             std::cerr << "Empty image data for: " << filename << std::endl;
             
             ocr::OCRResult result;
             result.set_image_id(imageId);
             result.set_success(false);
+            result.set_status(ocr::STATUS_FAILED);
             result.set_error_message("Empty image data");
             
-            std::lock_guard<std::mutex> lock(m_streamMutex);
-            stream->Write(result);
+            co_await write(std::move(result));
             continue;
         }
         
-        // Get a processor for this task (round-robin)
-        int processorIndex = m_nextProcessorIndex++ % m_processors.size();
-        OCRProcessor* processor = m_processors[processorIndex].get();
-        
-        activeTasks++;
-        g_activeImageSize += imageData.size();
-        
-        // Enqueue the OCR task
-        m_threadPool.enqueue([this, stream, processor, imageId, filename, imageData, &activeTasks]() {
-            std::string extractedText;
-            
-            try {
-                // ADDED: 1-second delay for testing continuous upload feature
-                std::cout << "Starting OCR processing for: " << filename << " (1 second delay for testing)" << std::endl;
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                
-                extractedText = processor->processImage(imageData, filename);
-            } catch (const std::exception& e) {
-                std::cerr << "Exception in OCR processing for " << filename << ": " << e.what() << std::endl;
-                extractedText = "";
-            }
-            
-            // Update memory usage and active tasks
-            g_activeImageSize -= imageData.size();
-            activeTasks--;
+        // Each profile has its own processors; a disabled one can't be served
+        if (!m_pipeline.hasProfile(m_request.profile())) {
+            std::cerr << "Unknown OCR profile " << m_request.profile() << " for: " << filename << std::endl;
             
             ocr::OCRResult result;
             result.set_image_id(imageId);
-            result.set_extracted_text(extractedText);
-            result.set_success(!extractedText.empty());
-            
-            if (extractedText.empty()) {
-                result.set_error_message("OCR failed to extract text");
-            }
+            result.set_success(false);
+            result.set_status(ocr::STATUS_FAILED);
+            result.set_error_message("Unknown or disabled OCR profile: " + m_request.profile());
             
-            // PROTECT STREAM WRITE WITH MUTEX
-            {
-                std::lock_guard<std::mutex> lock(m_streamMutex);
-                if (!stream->Write(result)) {
-                    std::cerr << "Failed to send result for image: " << imageId << std::endl;
-                } else {
-                    std::cout << "Sent result for image: " << imageId 
-                              << " Text: " << (extractedText.empty() ? "[EMPTY]" : extractedText.substr(0, 30)) 
-                              << " Memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
-                }
-            }
-        });
+            co_await write(std::move(result));
+            continue;
+        }
         
-        // Small delay between enqueuing tasks to prevent overwhelming the system
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto job = std::make_shared<OCRJob>();
+        job->imageId = imageId;
+        job->filename = filename;
+        job->imageData = std::move(*m_request.mutable_image_data());
+        job->binarization = toBinarizationMode(m_request.binarization());
+        job->profile = m_request.profile();
+        if (m_request.report_progress()) {
+            job->onProgress = progressReporter(imageId);
+        }
+        
+        // Suspends while the server is at capacity, which stops this
+        // stream from reading further images until a slot frees up
+        co_await m_pipeline.admit();
+        
+        int pending;
+        {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            pending = ++m_pending;
+        }
+        g_activeImageSize += imageSize;
+        
+        std::cout << "Processing image: " << filename 
+                  << " Size: " << imageSize << " bytes" 
+                  << " Pending for client: " << pending
+                  << " Total memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
+        
+        handleImage(std::move(job), imageSize);
+    }
+    
+    // Results can only be written while the stream is open
+    co_await drained();
+    Finish(grpc::Status::OK);
+}
+
+DetachedTask OCRStreamReactor::handleImage(std::shared_ptr<OCRJob> job, size_t imageSize) {
+    co_await m_pipeline.process(job);
+    
+    // Update memory usage
+    g_activeImageSize -= imageSize;
+    
+    ocr::OCRResult result;
+    result.set_image_id(job->imageId);
+    result.set_extracted_text(job->text);
+    
+    // A blank page is an answer, not a failure
+    bool noText = job->text.empty() && job->preprocess.noText;
+    result.set_success(!job->text.empty() || noText);
+    if (!job->text.empty()) {
+        result.set_status(ocr::STATUS_TEXT);
+    } else if (noText) {
+        result.set_status(ocr::STATUS_NO_TEXT);
+    } else if (job->monitor.expired) {
+        result.set_status(ocr::STATUS_TIMED_OUT);
+        result.set_error_message("OCR took longer than the server allows per image");
+    } else {
+        result.set_status(ocr::STATUS_FAILED);
+        result.set_error_message(job->error.empty() ? "OCR failed to extract text" : job->error);
+    }
+    
+    if (!co_await write(std::move(result))) {
+        std::cerr << "Failed to send result for image: " << job->imageId << std::endl;
+    } else {
+        std::cout << "Sent result for image: " << job->imageId 
+                  << " Text: " << (noText ? "[NO TEXT]" : job->monitor.expired ? "[TIMED OUT]"
+                                                      : job->text.empty() ? "[EMPTY]" : job->text.substr(0, 30)) 
+                  << " Preprocess: " << job->decodeMs << "ms (" << formatStageTimings(job->preprocess)
+                  << (job->preprocess.needsOSD ? "OSD" : "fast path")
+                  << (job->preprocess.cropped ? ", cropped" : "") << ")"
+                  << " Recognize: " << job->recognizeMs << "ms"
+                  << (!job->cascade.ranFastPass ? "" : job->cascade.escalated ? " (escalated" : " (fast pass")
+                  << (job->cascade.ranFastPass ? ", confidence " + std::to_string(job->cascade.fastConfidence) + ")" : "")
+                  << (job->retry.variantsRun == 0 ? "" : " Retry: " + std::to_string(static_cast<int>(job->retry.ms)) + "ms, " +
+                      std::to_string(job->retry.variantsRun) + " variants, " +
+                      (job->retry.recoveredBy.empty() ? std::string("no text")
+                                                      : job->retry.recoveredBy + " won at confidence " +
+                                                        std::to_string(job->retry.confidence)))
+                  << " Memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
+    }
+    
+    m_pipeline.release();
+    
+    std::coroutine_handle<> drainWaiter;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        if (--m_pending == 0) {
+            drainWaiter = std::exchange(m_drainWaiter, nullptr);
+        }
+    }
+    if (drainWaiter) {
+        drainWaiter.resume();
+    }
+}
+
+OCRServiceImpl::OCRServiceImpl(const PipelineConfig& config)
+    : OCRServiceImpl(config, OCRPipeline::prepareProcessors(config)) {
+}
+
+OCRServiceImpl::OCRServiceImpl(const PipelineConfig& config, PreparedProcessors prepared)
+    : m_pipeline(config, std::move(prepared))
+    , m_cleanupRunning(true)
+    , m_recycleProcessors(config.recycleProcessors)
+{
+    // Start memory cleanup thread
+    m_cleanupThread = std::thread(&OCRServiceImpl::memoryCleanupTask, this);
+    
+    std::cout << "OCR Service initialized with " << m_pipeline.processorCount() << " processors" 
+              << " (" << config.decodeThreads << " decode, " << config.outputThreads << " output threads)" << std::endl;
+}
+
+OCRServiceImpl::~OCRServiceImpl() {
+    m_cleanupRunning = false;
+    if (m_cleanupThread.joinable()) {
+        m_cleanupThread.join();
     }
     
-    // Wait for all pending tasks to complete before returning
-    m_threadPool.waitAll();
+    m_pipeline.waitAll();
+}
+
+void OCRServiceImpl::memoryCleanupTask() {
+    while (m_cleanupRunning) {
+        std::this_thread::sleep_for(std::chrono::seconds(30)); // Cleanup every 30 seconds
+        
+        // Force cleanup by recreating processors periodically
+        std::cout << "Performing memory cleanup..." << std::endl;
+        
+        // Busy processors are swapped out by the pipeline once they finish
+        if (m_recycleProcessors) {
+            m_pipeline.recycleProcessors();
+        }
+        
+        PixMemoryPool::Stats pool = PixMemoryPool::stats();
+        std::cout << "Memory cleanup completed. Image buffers: " << (pool.outstandingBytes / 1024 / 1024) << "MB in use, "
+                  << (pool.cachedBytes / 1024 / 1024) << "MB pooled, "
+                  << pool.hits << " reused / " << pool.misses << " allocated" << std::endl;
+        
+        CascadeStats cascade = OCRProcessor::cascadeStats();
+        if (cascade.fastPasses > 0) {
+            std::cout << "Recognition cascade: " << cascade.fastPasses << " images, "
+                      << (100.0 * cascade.escalations / cascade.fastPasses) << "% escalated, "
+                      << (cascade.fastMs / cascade.fastPasses) << "ms per fast pass";
+            // What a full pass costs is only known once one has run
+            if (cascade.escalations > 0) {
+                std::cout << ", " << (cascade.fullMs / cascade.escalations) << "ms per full pass, "
+                          << cascade.savedMs << "ms saved";
+            }
+            std::cout << std::endl;
+        }
+        
+        RetryStats retries = m_pipeline.retryStats();
+        if (retries.retried + retries.skipped > 0) {
+            std::cout << "Empty result retries: " << retries.retried << " retried, " << retries.recovered
+                      << " recovered, " << retries.skipped << " skipped with no idle processor" << std::endl;
+        }
+        
+        TimeoutStats timeouts = m_pipeline.timeoutStats();
+        if (timeouts.total > 0) {
+            std::cout << "Recognition timeouts: " << timeouts.lastHour << " in the last hour, "
+                      << timeouts.total << " since startup" << std::endl;
+        }
+        
+        uint64_t crashes = WorkerProcess::crashCount();
+        if (crashes > 0) {
+            std::cout << "OCR worker processes replaced after crashing: " << crashes << std::endl;
+        }
+    }
+}
+
+grpc::ServerBidiReactor<ocr::ImageRequest, ocr::OCRResult>* OCRServiceImpl::ProcessImages(
+    grpc::CallbackServerContext* /*context*/) {
     
-    std::cout << "Client disconnected. Final memory: " << (g_activeImageSize.load() / 1024 / 1024) << "MB" << std::endl;
-    return grpc::Status::OK;
+    // The reactor deletes itself once the stream is done
+    return new OCRStreamReactor(m_pipeline);
 }
\ No newline at end of file
@@ -2,33 +2,34 @@
 #define OCRSERVICE_H
 
 #include "ocr_service.grpc.pb.h"
-#include "OCRProcessor.h"
-#include "ThreadPool.h"
+#include "OCRPipeline.h"
 #include <grpcpp/grpcpp.h>
 #include <memory>
 #include <atomic>
 #include <mutex>
 #include <thread>
 
-class OCRServiceImpl final : public ocr::OCRService::Service {
+// Uses the callback API: each stream is driven by a reactor whose reads,
+// writes and pipeline stages are co_awaited, so in-flight images cost a
+// coroutine frame rather than a parked thread.
+class OCRServiceImpl final : public ocr::OCRService::CallbackService {
 public:
-    OCRServiceImpl(size_t numThreads = 4);
+    OCRServiceImpl(const PipelineConfig& config = PipelineConfig());
+    // With processors initialized beforehand, e.g. in a zygote process
+    OCRServiceImpl(const PipelineConfig& config, PreparedProcessors prepared);
     ~OCRServiceImpl();
     
-    grpc::Status ProcessImages(
-        grpc::ServerContext* context,
-        grpc::ServerReaderWriter<ocr::OCRResult, ocr::ImageRequest>* stream
+    grpc::ServerBidiReactor<ocr::ImageRequest, ocr::OCRResult>* ProcessImages(
+        grpc::CallbackServerContext* context
     ) override;
 
 private:
     void memoryCleanupTask();
     
-    ThreadPool m_threadPool;
-    std::atomic<int> m_nextProcessorIndex;
-    std::vector<std::unique_ptr<OCRProcessor>> m_processors;
-    std::mutex m_streamMutex;
+    OCRPipeline m_pipeline;
     std::thread m_cleanupThread;
     std::atomic<bool> m_cleanupRunning;
+    bool m_recycleProcessors;
 };
 
 #endif // OCRSERVICE_H
\ No newline at end of file
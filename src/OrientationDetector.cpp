@@ -0,0 +1,76 @@
+#include "OrientationDetector.h"
+#include <iostream>
+
+// Tesseract's own PSM_AUTO_OSD only rotates a page past this margin
+// (min_orientation_margin)
+static const float MIN_ORIENTATION_CONFIDENCE = 7.0f;
+
+OrientationDetector::~OrientationDetector() {
+    for (auto& engine : m_idle) {
+        engine->End();
+    }
+}
+
+std::shared_ptr<OrientationDetector> OrientationDetector::create(const std::string& tessdataPath) {
+    std::shared_ptr<OrientationDetector> detector(new OrientationDetector());
+    detector->m_model = TrainedData::load(tessdataPath, "osd");
+    if (!detector->m_model) {
+        return nullptr;
+    }
+
+    // The first engine shows the model loads; the rest follow on demand
+    std::unique_ptr<tesseract::TessBaseAPI> engine = detector->createEngine();
+    if (!engine) {
+        std::cerr << "Cannot load " << detector->m_model->path() << std::endl;
+        return nullptr;
+    }
+    detector->m_idle.push_back(std::move(engine));
+    return detector;
+}
+
+// osd.traineddata only has the legacy classifier
+std::unique_ptr<tesseract::TessBaseAPI> OrientationDetector::createEngine() const {
+    auto engine = std::make_unique<tesseract::TessBaseAPI>();
+    if (engine->Init(m_model->data(), m_model->size(), "osd", tesseract::OEM_TESSERACT_ONLY,
+                     nullptr, 0, nullptr, nullptr, false, nullptr)) {
+        return nullptr;
+    }
+    engine->SetPageSegMode(tesseract::PSM_OSD_ONLY);
+    return engine;
+}
+
+Pix* OrientationDetector::upright(Pix* image) {
+    std::unique_ptr<tesseract::TessBaseAPI> engine;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_idle.empty()) {
+            engine = std::move(m_idle.back());
+            m_idle.pop_back();
+        }
+    }
+    if (!engine) {
+        engine = createEngine();
+        if (!engine) {
+            return nullptr;
+        }
+    }
+
+    int degrees = 0;
+    float confidence = 0.0f;
+    const char* script = nullptr;
+    float scriptConfidence = 0.0f;
+    engine->SetImage(image);
+    bool detected = engine->DetectOrientationScript(&degrees, &confidence, &script, &scriptConfidence);
+    engine->Clear();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(std::move(engine));
+    }
+
+    if (!detected || degrees % 360 == 0 || confidence < MIN_ORIENTATION_CONFIDENCE) {
+        return nullptr;
+    }
+    // degrees is how far the page is turned clockwise; pixRotateOrth turns
+    // clockwise in quarters
+    return pixRotateOrth(image, (4 - (degrees / 90) % 4) % 4);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef ORIENTATIONDETECTOR_H
+#define ORIENTATIONDETECTOR_H
+
+#include <tesseract/baseapi.h>
+#include <leptonica/allheaders.h>
+#include "TrainedData.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Orientation detection with Tesseract's osd model, kept apart from the
+// recognition engines. Those are initialized from a model in memory, which
+// leaves them without a tessdata directory to find osd.traineddata in, so
+// PSM_AUTO_OSD can't run on them. One detector serves every processor in a
+// process; its engines are only created when more pages need OSD at the
+// same time than there are idle ones.
+class OrientationDetector {
+public:
+    ~OrientationDetector();
+
+    // Finds osd.traineddata like TrainedData::load(tessdataPath). nullptr if
+    // it isn't there or doesn't load.
+    static std::shared_ptr<OrientationDetector> create(const std::string& tessdataPath);
+
+    // A copy of image turned upright, or nullptr when it already is or the
+    // orientation is too uncertain to act on
+    Pix* upright(Pix* image);
+
+    const std::string& path() const { return m_model->path(); }
+
+private:
+    OrientationDetector() = default;
+
+    std::unique_ptr<tesseract::TessBaseAPI> createEngine() const;
+
+    std::shared_ptr<const TrainedData> m_model;
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<tesseract::TessBaseAPI>> m_idle;
+};
+
+#endif // ORIENTATIONDETECTOR_H
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "PixMemoryPool.h"
+#include <leptonica/allheaders.h>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Size classes are spaced a quarter of a power of two apart, so a buffer
+// is never more than 25% larger than requested
+static const int MIN_CLASS_SHIFT = 16;      // 64 KB, matches MIN_POOLED_BYTES
+static const int MAX_CLASS_SHIFT = 31;      // Larger buffers aren't pooled
+static const int CLASS_COUNT = (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT) * 4;
+static const int UNPOOLED = -1;
+
+static int sizeClassFor(size_t size) {
+    if (size < PixMemoryPool::MIN_POOLED_BYTES) {
+        return UNPOOLED;
+    }
+    int exponent = std::bit_width(size) - 1;
+    size_t step = size_t(1) << (exponent - 2);
+    size_t quarters = (size - (size_t(1) << exponent) + step - 1) / step;
+    int sizeClass = (exponent - MIN_CLASS_SHIFT) * 4 + static_cast<int>(quarters);
+    return sizeClass < CLASS_COUNT ? sizeClass : UNPOOLED;
+}
+
+static size_t classBytes(int sizeClass) {
+    int exponent = MIN_CLASS_SHIFT + sizeClass / 4;
+    return (size_t(1) << exponent) + (sizeClass % 4) * (size_t(1) << (exponent - 2));
+}
+
+// Every class has its own stretch of one address range reserved by
+// install(): a block's class follows from its address, without a lookup or
+// a header, and a buffer outside the range was never the pool's. Pages are
+// only committed as blocks are first used.
+static const size_t REGION_BYTES = size_t(1) << 34;     // 16 GB of address space per class
+
+static PixPoolLimits g_limits;
+static char* g_base = nullptr;                          // Set once, before the pool is installed
+static std::atomic<size_t> g_carved[CLASS_COUNT];       // Blocks taken from each region so far
+static std::atomic<bool> g_installed{false};
+static std::atomic<uint64_t> g_hits{0};
+static std::atomic<uint64_t> g_misses{0};
+static std::atomic<size_t> g_cachedBytes{0};
+static std::atomic<size_t> g_outstandingBytes{0};
+static std::atomic<PixArena*> g_arena{nullptr};
+static thread_local bool t_useArena = false;
+
+static char* reserveRegions() {
+    size_t bytes = REGION_BYTES * CLASS_COUNT;
+#ifdef _WIN32
+    return static_cast<char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS));
+#else
+    void* range = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return range == MAP_FAILED ? nullptr : static_cast<char*>(range);
+#endif
+}
+
+// POSIX commits pages on first touch by itself
+static bool commit(void* block, size_t bytes) {
+#ifdef _WIN32
+    return VirtualAlloc(block, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    (void)block;
+    (void)bytes;
+    return true;
+#endif
+}
+
+static void decommit(void* block, size_t bytes) {
+#ifdef _WIN32
+    VirtualFree(block, bytes, MEM_DECOMMIT);
+#else
+    madvise(block, bytes, MADV_DONTNEED);
+#endif
+}
+
+static int regionClass(void* ptr) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t base = reinterpret_cast<uintptr_t>(g_base);
+    if (!g_base || address < base || address - base >= REGION_BYTES * CLASS_COUNT) {
+        return UNPOOLED;
+    }
+    return static_cast<int>((address - base) / REGION_BYTES);
+}
+
+// A block no one has used yet; nullptr once the class's region is used up
+static void* carveBlock(int sizeClass) {
+    size_t bytes = classBytes(sizeClass);
+    size_t index = g_carved[sizeClass]++;
+    if ((index + 1) * bytes > REGION_BYTES) {
+        return nullptr;
+    }
+    void* block = g_base + sizeClass * REGION_BYTES + index * bytes;
+    return commit(block, bytes) ? block : nullptr;
+}
+
+// Counts bytes as cached, unless that would take the process over
+// totalCacheBytes
+static bool reserveCached(size_t bytes) {
+    size_t cached = g_cachedBytes.load();
+    do {
+        if (cached + bytes > g_limits.totalCacheBytes) {
+            return false;
+        }
+    } while (!g_cachedBytes.compare_exchange_weak(cached, cached + bytes));
+    return true;
+}
+
+// Shared between all threads. Never destroyed, because Leptonica may still
+// release buffers from static destructors at exit. Released blocks have
+// given their memory back and only keep their place in the region.
+struct SharedCache {
+    std::mutex mutex;
+    std::vector<void*> freeLists[CLASS_COUNT];
+    std::vector<void*> released[CLASS_COUNT];
+    size_t bytes = 0;
+};
+
+static SharedCache& sharedCache() {
+    static SharedCache* cache = new SharedCache();
+    return *cache;
+}
+
+static bool pushShared(void* block, int sizeClass) {
+    size_t bytes = classBytes(sizeClass);
+    SharedCache& cache = sharedCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.bytes + bytes > g_limits.sharedCacheBytes) {
+        return false;
+    }
+    cache.freeLists[sizeClass].push_back(block);
+    cache.bytes += bytes;
+    return true;
+}
+
+static void* popShared(int sizeClass) {
+    SharedCache& cache = sharedCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto& list = cache.freeLists[sizeClass];
+    if (list.empty()) {
+        return nullptr;
+    }
+    void* block = list.back();
+    list.pop_back();
+    cache.bytes -= classBytes(sizeClass);
+    return block;
+}
+
+// Gives the block's memory back to the system
+static void releaseBlock(void* block, int sizeClass) {
+    decommit(block, classBytes(sizeClass));
+    SharedCache& cache = sharedCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.released[sizeClass].push_back(block);
+}
+
+static void* reuseReleased(int sizeClass) {
+    void* block = nullptr;
+    {
+        SharedCache& cache = sharedCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto& list = cache.released[sizeClass];
+        if (list.empty()) {
+            return nullptr;
+        }
+        block = list.back();
+        list.pop_back();
+    }
+    if (!commit(block, classBytes(sizeClass))) {
+        releaseBlock(block, sizeClass);
+        return nullptr;
+    }
+    return block;
+}
+
+// A plain bool, so it can still be read once t_cache has been destroyed
+// at thread exit, when Leptonica may release buffers from other thread
+// local destructors
+static thread_local bool t_cacheDestroyed = false;
+
+// Per-thread cache, drained into the shared pool when the thread exits
+struct ThreadCache {
+    std::vector<void*> freeLists[CLASS_COUNT];
+    size_t bytes = 0;
+
+    ~ThreadCache() {
+        t_cacheDestroyed = true;
+        for (int sizeClass = 0; sizeClass < CLASS_COUNT; ++sizeClass) {
+            for (void* block : freeLists[sizeClass]) {
+                if (!pushShared(block, sizeClass)) {
+                    g_cachedBytes -= classBytes(sizeClass);
+                    releaseBlock(block, sizeClass);
+                }
+            }
+        }
+    }
+};
+
+static thread_local ThreadCache t_cache;
+
+void PixMemoryPool::install(const PixPoolLimits& limits) {
+    g_limits = limits;
+    if (!g_base) {
+        g_base = reserveRegions();
+        if (!g_base) {
+            std::cerr << "Cannot reserve address space for the Pix memory pool, image buffers won't be reused"
+                      << std::endl;
+        }
+    }
+    setPixMemoryManager(&PixMemoryPool::allocate, &PixMemoryPool::deallocate);
+    g_installed = true;
+}
+
+bool PixMemoryPool::installed() {
+    return g_installed;
+}
+
+PixMemoryPool::Stats PixMemoryPool::stats() {
+    return Stats{g_hits.load(), g_misses.load(), g_cachedBytes.load(), g_outstandingBytes.load()};
+}
+
+void PixMemoryPool::setArena(PixArena* arena) {
+    g_arena = arena;
+}
+
+PixMemoryPool::ArenaScope::ArenaScope(bool enabled)
+    : m_previous(t_useArena) {
+    t_useArena = enabled;
+}
+
+PixMemoryPool::ArenaScope::~ArenaScope() {
+    t_useArena = m_previous;
+}
+
+void* PixMemoryPool::allocate(size_t size) {
+    if (t_useArena && size >= MIN_POOLED_BYTES) {
+        PixArena* arena = g_arena.load(std::memory_order_acquire);
+        if (void* block = arena ? arena->allocate(size) : nullptr) {
+            return block;
+        }
+    }
+
+    int sizeClass = g_base ? sizeClassFor(size) : UNPOOLED;
+    if (sizeClass == UNPOOLED) {
+        return std::malloc(size);
+    }
+
+    size_t bytes = classBytes(sizeClass);
+    void* block = nullptr;
+    if (!t_cacheDestroyed && !t_cache.freeLists[sizeClass].empty()) {
+        block = t_cache.freeLists[sizeClass].back();
+        t_cache.freeLists[sizeClass].pop_back();
+        t_cache.bytes -= bytes;
+    } else {
+        block = popShared(sizeClass);
+    }
+
+    if (block) {
+        g_hits++;
+        g_cachedBytes -= bytes;
+    } else {
+        block = reuseReleased(sizeClass);
+        if (!block) {
+            block = carveBlock(sizeClass);
+        }
+        if (!block) {
+            // The class's region is full; an ordinary buffer still works
+            return std::malloc(size);
+        }
+        g_misses++;
+    }
+    g_outstandingBytes += bytes;
+    return block;
+}
+
+void PixMemoryPool::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    PixArena* arena = g_arena.load(std::memory_order_acquire);
+    if (arena && arena->owns(ptr)) {
+        arena->deallocate(ptr);
+        return;
+    }
+    int sizeClass = regionClass(ptr);
+    if (sizeClass == UNPOOLED) {
+        std::free(ptr);
+        return;
+    }
+
+    size_t bytes = classBytes(sizeClass);
+    g_outstandingBytes -= bytes;
+    if (!reserveCached(bytes)) {
+        releaseBlock(ptr, sizeClass);
+        return;
+    }
+
+    if (!t_cacheDestroyed && t_cache.bytes + bytes <= g_limits.threadCacheBytes) {
+        t_cache.freeLists[sizeClass].push_back(ptr);
+        t_cache.bytes += bytes;
+        return;
+    }
+    if (pushShared(ptr, sizeClass)) {
+        return;
+    }
+
+    g_cachedBytes -= bytes;
+    releaseBlock(ptr, sizeClass);
+}
\ No newline at end of file
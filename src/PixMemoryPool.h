@@ -0,0 +1,78 @@
+#ifndef PIXMEMORYPOOL_H
+#define PIXMEMORYPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Caps on the memory PixMemoryPool keeps around for reuse
+struct PixPoolLimits {
+    size_t threadCacheBytes = 64 * 1024 * 1024;     // Per worker thread
+    size_t sharedCacheBytes = 256 * 1024 * 1024;    // Across all threads
+    size_t totalCacheBytes = 512 * 1024 * 1024;     // Everything cached, thread caches
+                                                    // included, however many threads
+};
+
+// Memory that rasters can be allocated from instead of the pool, such as
+// memory shared with other processes (SharedImageArena)
+class PixArena {
+public:
+    virtual ~PixArena() = default;
+    virtual void* allocate(size_t size) = 0;    // nullptr when full
+    virtual void deallocate(void* ptr) = 0;
+    virtual bool owns(const void* ptr) const = 0;
+};
+
+// Size-classed free lists for Leptonica image buffers, installed through
+// setPixMemoryManager. Every worker thread keeps a small cache of released
+// buffers; what doesn't fit there goes to a shared pool, and only what
+// exceeds both caps goes back to the heap. Repeatedly decoding similar
+// pages therefore reuses the same few page-sized blocks instead of
+// fragmenting the heap.
+//
+// Buffers smaller than MIN_POOLED_BYTES are passed straight to malloc.
+// Pooled blocks come from address space reserved per size class, so
+// releasing one finds its class from the address alone, without a lock or
+// a header; a buffer outside that space (allocated before install(), or
+// given to Leptonica by pixSetData) goes back to free() as Leptonica's own
+// allocator would have done. Blocks beyond the caps give their memory back
+// to the system but keep their place for reuse.
+class PixMemoryPool {
+public:
+    struct Stats {
+        uint64_t hits;              // Allocations served from a cache
+        uint64_t misses;            // Allocations that went to malloc
+        size_t cachedBytes;         // Held in caches right now
+        size_t outstandingBytes;    // Handed out to Leptonica right now
+    };
+
+    static const size_t MIN_POOLED_BYTES = 64 * 1024;
+
+    // Best called before the first Pix is created, so every buffer can be
+    // reused
+    static void install(const PixPoolLimits& limits = PixPoolLimits());
+    static bool installed();
+
+    static Stats stats();
+
+    // Large rasters allocated on a thread while an ArenaScope is open there
+    // come from arena, as long as it has room. Set once; the arena must
+    // outlive every Pix allocated from it.
+    static void setArena(PixArena* arena);
+
+    class ArenaScope {
+    public:
+        explicit ArenaScope(bool enabled = true);
+        ~ArenaScope();
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+    private:
+        bool m_previous;
+    };
+
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr);
+};
+
+#endif // PIXMEMORYPOOL_H
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "Preprocessor.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+// State carried from one stage to the next
+struct StageContext {
+    const PreprocessOptions& options;
+    PreprocessInfo& info;
+    int textHeight;         // Current character height in pixels, 0 if unknown
+    bool textHeightKnown;   // Measured (or given up on) already
+};
+
+bool PreprocessOptions::runs(PreprocessStage stage) const {
+    if (std::find(stages.begin(), stages.end(), stage) == stages.end()) {
+        return false;
+    }
+    switch (stage) {
+        case PreprocessStage::Scale: return rescale;
+        case PreprocessStage::Deskew: return fastOrientation;
+        case PreprocessStage::Crop: return cropToText;
+        default: return true;
+    }
+}
+
+// Measured on first use, so pipelines without Scale or Crop never pay for it
+static int textHeight(Pix* pix, StageContext& context) {
+    if (!context.textHeightKnown) {
+        context.textHeight = estimateTextHeight(pix);
+        if (context.textHeight == 0 && context.options.singleLine) {
+            // Too few characters to measure; a tight crop is mostly text
+            context.textHeight = pixGetHeight(pix) * 6 / 10;
+        }
+        context.textHeightKnown = true;
+    }
+    return context.textHeight;
+}
+
+static Pix* convertStage(Pix* pix, StageContext& /*context*/) {
+    if (pixGetDepth(pix) == 8 && !pixGetColormap(pix)) {
+        return pix;
+    }
+    Pix* gray = pixConvertTo8(pix, 0);
+    pixDestroy(&pix);
+    return gray;
+}
+
+static Pix* denoiseStage(Pix* pix, StageContext& context) {
+    if (pixGetDepth(pix) == 1) {
+        // Median filtering only makes sense on gray levels
+        return pix;
+    }
+    pix = convertStage(pix, context);
+    if (!pix) {
+        return nullptr;
+    }
+    Pix* denoised = pixMedianFilter(pix, 1, 1);
+    pixDestroy(&pix);
+    return denoised;
+}
+
+static Pix* normalizeStage(Pix* pix, StageContext& /*context*/) {
+    l_int32 depth = pixGetDepth(pix);
+    if ((depth != 8 && depth != 32) || pixGetColormap(pix)) {
+        return pix;
+    }
+    Pix* normalized = pixBackgroundNormSimple(pix, nullptr, nullptr);
+    if (!normalized) {
+        // Leptonica refuses images too small for its tiles; not an error
+        return pix;
+    }
+    pixDestroy(&pix);
+    return normalized;
+}
+
+static Pix* binarizeStage(Pix* pix, StageContext& context) {
+    if (pixGetDepth(pix) == 1) {
+        return pix;
+    }
+    BinarizationMode mode = context.options.binarization;
+    Pix* binary = nullptr;
+    if (mode == BinarizationMode::Otsu || mode == BinarizationMode::Sauvola) {
+        // Local thresholds for unevenly lit photos
+        binary = binarizeAdaptive(pix, mode);
+    } else {
+        // Grayscale conversion and simple thresholding fused into one pass,
+        // without the intermediate 8 bpp image
+        binary = binarizeGlobal(pix, 128);
+    }
+    pixDestroy(&pix);
+    return binary;
+}
+
+static Pix* scaleStage(Pix* pix, StageContext& context) {
+    const float MIN_SCALE = 0.2f;
+    const float MAX_SCALE = 4.0f;
+
+    int height = textHeight(pix, context);
+    int target = context.options.targetTextHeight;
+    if (height <= 0 || target <= 0) {
+        return pix;
+    }
+
+    // Tesseract copes well with a range of sizes; only rescale when the text
+    // is clearly too small to recognize or large enough to waste time
+    if (!context.options.exactScale && height >= target * 0.8f && height <= target * 1.5f) {
+        return pix;
+    }
+    if (height == target) {
+        return pix;
+    }
+
+    float scale = std::clamp(static_cast<float>(target) / height, MIN_SCALE, MAX_SCALE);
+    Pix* scaled = pixScale(pix, scale, scale);
+    if (!scaled) {
+        return pix;
+    }
+
+    // Keep the DPI consistent with the new size so Tesseract's size
+    // heuristics see the same physical page
+    l_int32 xres = pixGetXRes(pix);
+    l_int32 yres = pixGetYRes(pix);
+    if (xres > 0 && yres > 0) {
+        pixSetResolution(scaled, static_cast<l_int32>(xres * scale + 0.5f),
+                         static_cast<l_int32>(yres * scale + 0.5f));
+    }
+
+    pixDestroy(&pix);
+    context.textHeight = static_cast<int>(height * scale + 0.5f);
+    return scaled;
+}
+
+static Pix* deskewStage(Pix* pix, StageContext& context) {
+    if (pixGetDepth(pix) != 1) {
+        return pix;
+    }
+    Pix* upright = normalizeOrientation(pix, context.info.orientation);
+    if (!upright) {
+        return pix;
+    }
+    pixDestroy(&pix);
+    context.info.needsOSD = false;
+    if (context.info.orientation.rotation % 180 != 0) {
+        // Measured across the lines of a sideways page, i.e. character widths
+        context.textHeightKnown = false;
+    }
+    return upright;
+}
+
+// Photos often have text in a small part of the frame; cropping to it
+// saves Tesseract segmenting the rest. Text lines are only found on an
+// upright page, so nothing is cropped until the orientation is known.
+static Pix* cropStage(Pix* pix, StageContext& context) {
+    if (pixGetDepth(pix) != 1 || context.info.needsOSD ||
+        !findTextBounds(pix, textHeight(pix, context), context.info.textBounds)) {
+        return pix;
+    }
+    const TextBounds& bounds = context.info.textBounds;
+    context.info.singleBlock = bounds.singleColumn;
+
+    long long area = static_cast<long long>(pixGetWidth(pix)) * pixGetHeight(pix);
+    if (static_cast<long long>(bounds.width) * bounds.height >= area * 0.8) {
+        return pix;
+    }
+
+    BOX* box = boxCreate(bounds.x, bounds.y, bounds.width, bounds.height);
+    Pix* cropped = pixClipRectangle(pix, box, nullptr);
+    boxDestroy(&box);
+    if (!cropped) {
+        return pix;
+    }
+    pixDestroy(&pix);
+    context.info.cropped = true;
+    return cropped;
+}
+
+static Pix* invertStage(Pix* pix, StageContext& /*context*/) {
+    Pix* inverted = pixInvert(nullptr, pix);
+    if (!inverted) {
+        return pix;
+    }
+    pixDestroy(&pix);
+    return inverted;
+}
+
+static Pix* runStage(PreprocessStage stage, Pix* pix, StageContext& context) {
+    switch (stage) {
+        case PreprocessStage::Convert: return convertStage(pix, context);
+        case PreprocessStage::Denoise: return denoiseStage(pix, context);
+        case PreprocessStage::Normalize: return normalizeStage(pix, context);
+        case PreprocessStage::Binarize: return binarizeStage(pix, context);
+        case PreprocessStage::Scale: return scaleStage(pix, context);
+        case PreprocessStage::Deskew: return deskewStage(pix, context);
+        case PreprocessStage::Crop: return cropStage(pix, context);
+        case PreprocessStage::Invert: return invertStage(pix, context);
+    }
+    return pix;
+}
+
+Pix* runPreprocessStages(Pix* pix, const PreprocessOptions& options, PreprocessInfo& info) {
+    StageContext context{options, info, 0, false};
+
+    // The crop waits for the orientation when both run
+    std::vector<PreprocessStage> stages = options.stages;
+    auto crop = std::find(stages.begin(), stages.end(), PreprocessStage::Crop);
+    auto deskew = std::find(stages.begin(), stages.end(), PreprocessStage::Deskew);
+    if (deskew != stages.end() && crop < deskew) {
+        std::rotate(crop, crop + 1, deskew + 1);
+    }
+
+    for (PreprocessStage stage : stages) {
+        if (!pix) {
+            break;
+        }
+        if (!options.runs(stage)) {
+            continue;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        pix = runStage(stage, pix, context);
+        auto end = std::chrono::high_resolution_clock::now();
+        info.stageTimings.push_back({stage, std::chrono::duration<double, std::milli>(end - start).count()});
+
+        if (!pix) {
+            std::cerr << "Preprocessing stage " << preprocessStageName(stage) << " failed" << std::endl;
+        }
+    }
+
+    if (context.textHeightKnown) {
+        info.textHeight = context.textHeight;
+    }
+    return pix;
+}
+
+static const PreprocessStage ALL_STAGES[] = {
+    PreprocessStage::Convert, PreprocessStage::Denoise, PreprocessStage::Normalize, PreprocessStage::Binarize,
+    PreprocessStage::Scale, PreprocessStage::Deskew, PreprocessStage::Crop, PreprocessStage::Invert
+};
+
+std::vector<PreprocessVariant> alternatePreprocessing(const PreprocessOptions& options) {
+    std::vector<PreprocessVariant> variants;
+    auto binarize = std::find(options.stages.begin(), options.stages.end(), PreprocessStage::Binarize);
+    bool binarizes = binarize != options.stages.end();
+
+    // Deskew and crop look for dark text, so invert before they run
+    if (std::find(options.stages.begin(), options.stages.end(), PreprocessStage::Invert) == options.stages.end()) {
+        PreprocessVariant inverted{"inverted", options};
+        auto position = inverted.options.stages.begin() + (binarizes ? (binarize - options.stages.begin()) + 1 : 0);
+        inverted.options.stages.insert(position, PreprocessStage::Invert);
+        variants.push_back(inverted);
+    }
+
+    if (binarizes) {
+        PreprocessVariant threshold{"adaptive threshold", options};
+        bool adaptive = options.binarization == BinarizationMode::Otsu ||
+                        options.binarization == BinarizationMode::Sauvola;
+        threshold.options.binarization = adaptive ? BinarizationMode::Global : BinarizationMode::Sauvola;
+        if (adaptive) {
+            threshold.name = "global threshold";
+        }
+        variants.push_back(threshold);
+    }
+
+    // Small text, or a crop that cut some of it off. Half as large again
+    // is inside the band the scale stage normally leaves alone.
+    PreprocessVariant rescaled{"rescaled", options};
+    rescaled.options.targetTextHeight = options.targetTextHeight * 3 / 2;
+    rescaled.options.rescale = true;
+    rescaled.options.exactScale = true;
+    rescaled.options.cropToText = false;
+    if (std::find(options.stages.begin(), options.stages.end(), PreprocessStage::Scale) == options.stages.end()) {
+        rescaled.options.stages.insert(rescaled.options.stages.begin(), PreprocessStage::Scale);
+    }
+    variants.push_back(rescaled);
+
+    return variants;
+}
+
+bool parsePreprocessStages(const std::string& spec, std::vector<PreprocessStage>& stages) {
+    std::vector<PreprocessStage> parsed;
+    std::stringstream stream(spec);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (name.empty()) {
+            continue;
+        }
+        auto match = std::find_if(std::begin(ALL_STAGES), std::end(ALL_STAGES),
+                                  [&](PreprocessStage stage) { return name == preprocessStageName(stage); });
+        if (match == std::end(ALL_STAGES)) {
+            return false;
+        }
+        parsed.push_back(*match);
+    }
+    stages = std::move(parsed);
+    return true;
+}
+
+std::string preprocessStagesName(const std::vector<PreprocessStage>& stages) {
+    std::string name;
+    for (PreprocessStage stage : stages) {
+        if (!name.empty()) {
+            name += ",";
+        }
+        name += preprocessStageName(stage);
+    }
+    return name;
+}
+
+const char* preprocessStageName(PreprocessStage stage) {
+    switch (stage) {
+        case PreprocessStage::Convert: return "convert";
+        case PreprocessStage::Denoise: return "denoise";
+        case PreprocessStage::Normalize: return "normalize";
+        case PreprocessStage::Binarize: return "binarize";
+        case PreprocessStage::Scale: return "scale";
+        case PreprocessStage::Deskew: return "deskew";
+        case PreprocessStage::Crop: return "crop";
+        case PreprocessStage::Invert: return "invert";
+    }
+    return "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+#include <tesseract/baseapi.h>
+#include <leptonica/allheaders.h>
+#include "ImageKernels.h"
+#include <string>
+#include <vector>
+
+// Steps that turn a decoded image into the Pix handed to Tesseract
+enum class PreprocessStage {
+    Convert,        // To 8 bpp gray
+    Denoise,        // 3x3 median filter on gray
+    Normalize,      // Flatten uneven background illumination
+    Binarize,       // To 1 bpp with PreprocessOptions::binarization
+    Scale,          // Rescale so text lands near targetTextHeight
+    Deskew,         // Orientation and skew fast path; needs a binary image
+    Crop,           // Crop to the detected text lines; needs a binary, upright image,
+                    // so it runs after Deskew and only when that found the orientation
+    Invert          // Swap foreground and background, for light text on a dark background
+};
+
+// Options for turning encoded image bytes into the Pix handed to Tesseract
+struct PreprocessOptions {
+    std::vector<PreprocessStage> stages = {
+        PreprocessStage::Scale, PreprocessStage::Binarize, PreprocessStage::Deskew, PreprocessStage::Crop
+    };
+    BinarizationMode binarization = BinarizationMode::Global;
+    bool rescale = true;            // Scale so text lands near targetTextHeight
+    bool exactScale = false;        // Scale to targetTextHeight even when the text is
+                                    // already a size Tesseract copes with
+    int targetTextHeight = 24;      // Pixels; Tesseract is most accurate around 20-30
+    bool fastOrientation = true;    // Projection-profile orientation/skew, OSD only when unsure
+    bool cropToText = true;         // Crop away the area around detected text lines
+    bool singleLine = false;        // Image is one line or word; its height gives the text height
+    bool rejectBlank = true;        // Skip images with next to no ink or edges, answering
+                                    // STATUS_NO_TEXT; see PreprocessInfo::noText
+
+    // Whether a stage is in the graph and not switched off by its flag
+    bool runs(PreprocessStage stage) const;
+};
+
+struct StageTiming {
+    PreprocessStage stage;
+    double ms;
+};
+
+// What preprocessing found out about an image
+struct PreprocessInfo {
+    bool noText = false;            // Rejected as blank before preprocessing; not an error
+    bool needsOSD = true;           // Orientation unknown; recognize with PSM_AUTO_OSD
+    OrientationEstimate orientation;
+    TextBounds textBounds;          // Where the text is, before any cropping
+    bool cropped = false;
+    bool singleBlock = false;       // One column of text; layout analysis can be skipped
+    int textHeight = 0;             // Character height in the final image, 0 if not measured
+    std::vector<StageTiming> stageTimings;
+
+    // Cheapest segmentation mode that still suits the image
+    tesseract::PageSegMode pageSegMode() const {
+        if (needsOSD) {
+            return tesseract::PSM_AUTO_OSD;
+        }
+        return singleBlock ? tesseract::PSM_SINGLE_BLOCK : tesseract::PSM_AUTO;
+    }
+};
+
+// Runs options.stages over pix in order (except that Crop is put after
+// Deskew), timing each one. Takes ownership
+// of pix and returns the final image, or nullptr if a stage failed. Every
+// stage releases its input as soon as its output exists, so with
+// PixMemoryPool installed the next stage of the same size picks up the
+// buffer that was just freed; stages that have nothing to do pass their
+// input through untouched.
+Pix* runPreprocessStages(Pix* pix, const PreprocessOptions& options, PreprocessInfo& info);
+
+// Preprocessing worth a second try when the usual options yield no text
+struct PreprocessVariant {
+    const char* name;
+    PreprocessOptions options;
+};
+
+// Alternatives to options, most often successful first: inverted after
+// binarization, the other kind of threshold (adaptive or global), and
+// text scaled larger without cropping. Variants that would repeat options
+// are left out.
+std::vector<PreprocessVariant> alternatePreprocessing(const PreprocessOptions& options);
+
+// Comma-separated stage names, e.g. "convert,denoise,binarize"
+bool parsePreprocessStages(const std::string& spec, std::vector<PreprocessStage>& stages);
+std::string preprocessStagesName(const std::vector<PreprocessStage>& stages);
+const char* preprocessStageName(PreprocessStage stage);
+
+#endif // PREPROCESSOR_H
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "TextCorrector.h"
+#include "Lexicon.h"
+#include "TextNormalizer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+static bool isAlnum(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) != 0;
+}
+
+TextCorrector::TextCorrector(const std::vector<Rule>& rules) {
+    // Only bytes that occur in a pattern get their own column, which keeps
+    // the transition table small enough to stay in cache
+    std::memset(m_byteClass, 0, sizeof(m_byteClass));
+    for (const Rule& rule : rules) {
+        for (char c : rule.pattern) {
+            uint8_t& byteClass = m_byteClass[static_cast<unsigned char>(c)];
+            if (byteClass == 0) {
+                byteClass = static_cast<uint8_t>(m_classCount++);
+            }
+        }
+    }
+
+    m_next.assign(m_classCount, 0);
+    m_terminal.assign(1, -1);
+    for (const Rule& rule : rules) {
+        if (rule.pattern.empty()) {
+            continue;
+        }
+        int32_t node = 0;
+        for (char c : rule.pattern) {
+            int32_t& child = m_next[node * m_classCount + m_byteClass[static_cast<unsigned char>(c)]];
+            if (child == 0) {
+                child = static_cast<int32_t>(m_terminal.size());
+                m_terminal.push_back(-1);
+                m_next.resize(m_next.size() + m_classCount, 0);
+            }
+            node = m_next[node * m_classCount + m_byteClass[static_cast<unsigned char>(c)]];
+        }
+        if (m_terminal[node] == -1) {
+            m_terminal[node] = static_cast<int32_t>(m_rules.size());
+            m_rules.push_back(rule);
+        }
+    }
+}
+
+// Every rule matching at pos, shortest first
+int TextCorrector::findCandidates(std::string_view text, size_t pos, Candidate* candidates) const {
+    int count = 0;
+    int32_t node = 0;
+    for (size_t i = pos; i < text.size() && count < MAX_CANDIDATES; ++i) {
+        uint8_t byteClass = m_byteClass[static_cast<unsigned char>(text[i])];
+        if (byteClass == 0) {
+            break;
+        }
+        node = m_next[node * m_classCount + byteClass];
+        if (node == 0) {
+            break;
+        }
+        if (m_terminal[node] != -1) {
+            candidates[count++] = Candidate{m_terminal[node], i + 1 - pos};
+        }
+    }
+    return count;
+}
+
+// Whether the first character written for text[pos] will be alphanumeric
+bool TextCorrector::nextIsAlnum(std::string_view text, size_t pos) const {
+    if (pos >= text.size()) {
+        return false;
+    }
+    Candidate candidates[MAX_CANDIDATES];
+    int count = findCandidates(text, pos, candidates);
+    for (int i = count - 1; i >= 0; --i) {
+        const Rule& rule = m_rules[candidates[i].rule];
+        if (!rule.wholeWord) {
+            return !rule.replacement.empty() && isAlnum(rule.replacement[0]);
+        }
+    }
+    return isAlnum(text[pos]);
+}
+
+void TextCorrector::apply(std::string_view text, std::string& out) const {
+    out.clear();
+    out.reserve(text.size());
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        char c = text[pos];
+        uint8_t byteClass = m_byteClass[static_cast<unsigned char>(c)];
+
+        if (byteClass != 0 && m_next[byteClass] != 0) {
+            Candidate candidates[MAX_CANDIDATES];
+            int count = findCandidates(text, pos, candidates);
+            const Candidate* chosen = nullptr;
+            for (int i = count - 1; i >= 0 && !chosen; --i) {
+                const Rule& rule = m_rules[candidates[i].rule];
+                if (!rule.wholeWord ||
+                    ((out.empty() || !isAlnum(out.back())) && !nextIsAlnum(text, pos + candidates[i].length))) {
+                    chosen = &candidates[i];
+                }
+            }
+            if (chosen) {
+                out += m_rules[chosen->rule].replacement;
+                pos += chosen->length;
+                continue;
+            }
+        }
+
+        out.push_back(c);
+        ++pos;
+    }
+}
+
+// Single characters Tesseract commonly confuses, and spacing around
+// punctuation. Replacements aren't rescanned, so no rule can feed another.
+// Typographic quotes are already ASCII by now (normalizeText).
+static const std::pair<const char*, const char*> CHARACTER_RULES[] = {
+    {"|", "l"}, {"[", "l"}, {"]", "l"}, {"\\", "l"}, {"//", "l"},
+    {"``", "\""}, {"''", "\""}, {"`", "'"},
+
+    {" ,", ","}, {" .", "."}, {" ;", ";"}, {" :", ":"},
+    {"( ", "("}, {" )", ")"}, {"{ ", "{"}, {" }", "}"}, {" /", "/"}
+};
+
+// Whole words commonly misread, written as they look after the character
+// rules have run
+static const std::pair<const char*, const char*> WORD_RULES[] = {
+    {"lhe", "the"}, {"lhat", "that"}, {"lhis", "this"}, {"lhere", "there"}
+};
+
+// Digits Tesseract reads in place of letters, most likely letter first.
+// These are only swapped when a lexicon confirms the result is a word, so
+// numbers such as invoice and order IDs come through untouched.
+static const std::pair<char, const char*> DIGIT_CONFUSIONS[] = {
+    {'0', "o"}, {'1', "li"}, {'5', "s"}, {'6', "gb"}, {'8', "b"}, {'9', "gq"}
+};
+
+static const char* confusableLetters(char digit) {
+    for (const auto& confusion : DIGIT_CONFUSIONS) {
+        if (confusion.first == digit) {
+            return confusion.second;
+        }
+    }
+    return nullptr;
+}
+
+// Every raw spelling that the character rules turn into c, plus the digits
+// that look like it; the word rules are whole words, so these are safe
+static std::vector<std::string> spellingsOf(char c) {
+    std::vector<std::string> spellings;
+    bool replaced = false;
+    for (const auto& rule : CHARACTER_RULES) {
+        if (std::strlen(rule.first) == 1 && rule.first[0] == c) {
+            replaced = true;
+        }
+        if (std::strlen(rule.second) == 1 && rule.second[0] == c) {
+            spellings.push_back(rule.first);
+        }
+    }
+    for (const auto& confusion : DIGIT_CONFUSIONS) {
+        if (std::strchr(confusion.second, c)) {
+            spellings.push_back(std::string(1, confusion.first));
+        }
+    }
+    if (!replaced) {
+        spellings.insert(spellings.begin(), std::string(1, c));
+    }
+    return spellings;
+}
+
+// Folds the word rules into the character rules, so "|he" becomes "the" in
+// the same pass that would have turned it into "lhe"
+static std::vector<TextCorrector::Rule> buildCorrectionRules() {
+    std::vector<TextCorrector::Rule> rules;
+    for (const auto& word : WORD_RULES) {
+        std::vector<std::string> patterns = {""};
+        for (const char* c = word.first; *c; ++c) {
+            std::vector<std::string> extended;
+            for (const std::string& prefix : patterns) {
+                for (const std::string& spelling : spellingsOf(*c)) {
+                    extended.push_back(prefix + spelling);
+                }
+            }
+            patterns = std::move(extended);
+        }
+        for (const std::string& pattern : patterns) {
+            rules.push_back({pattern, word.second, true});
+        }
+    }
+    for (const auto& rule : CHARACTER_RULES) {
+        rules.push_back({rule.first, rule.second, false});
+    }
+    return rules;
+}
+
+static bool isAsciiAlnum(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Swaps confusable digits in word (which has at least one letter) for
+// letters when that spells a lexicon word and word itself isn't one. Tries
+// every combination of letters, most likely first.
+static void correctWord(char* word, size_t length, const Lexicon& lexicon) {
+    const int MAX_SWAPS = 3;
+    size_t positions[MAX_SWAPS];
+    const char* letters[MAX_SWAPS];
+    int swaps = 0;
+    int lowercase = 0;
+    int uppercase = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(word[i]);
+        if (std::isdigit(c)) {
+            const char* options = confusableLetters(word[i]);
+            if (!options || swaps == MAX_SWAPS) {
+                return;
+            }
+            positions[swaps] = i;
+            letters[swaps] = options;
+            swaps++;
+        } else if (std::islower(c)) {
+            lowercase++;
+        } else if (std::isupper(c)) {
+            uppercase++;
+        }
+    }
+    if (swaps == 0 || lexicon.contains(std::string_view(word, length))) {
+        return;
+    }
+
+    char candidate[Lexicon::MAX_WORD_LENGTH];
+    std::memcpy(candidate, word, length);
+    int choice[MAX_SWAPS] = {};
+    while (true) {
+        for (int i = 0; i < swaps; ++i) {
+            candidate[positions[i]] = letters[i][choice[i]];
+        }
+        if (lexicon.contains(std::string_view(candidate, length))) {
+            break;
+        }
+        // Next combination, like an odometer
+        int i = 0;
+        while (i < swaps && letters[i][++choice[i]] == '\0') {
+            choice[i++] = 0;
+        }
+        if (i == swaps) {
+            return;
+        }
+    }
+
+    // Match the case of the rest of the word: all caps, capitalized, or lower
+    for (int i = 0; i < swaps; ++i) {
+        size_t position = positions[i];
+        bool upper = lowercase == 0 ||
+                     (position == 0 && length > 1 && std::isupper(static_cast<unsigned char>(word[1])));
+        word[position] = upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(candidate[position])))
+                               : candidate[position];
+    }
+}
+
+static void correctConfusableDigits(std::string& text, const Lexicon& lexicon) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (!isAsciiAlnum(text[pos])) {
+            pos++;
+            continue;
+        }
+        size_t start = pos;
+        bool hasDigit = false;
+        bool hasLetter = false;
+        for (; pos < text.size() && isAsciiAlnum(text[pos]); ++pos) {
+            bool digit = text[pos] >= '0' && text[pos] <= '9';
+            hasDigit |= digit;
+            hasLetter |= !digit;
+        }
+        // Pure numbers are left alone; they are what this protects
+        if (hasDigit && hasLetter && pos - start <= Lexicon::MAX_WORD_LENGTH) {
+            correctWord(&text[start], pos - start, lexicon);
+        }
+    }
+}
+
+static bool isLikelyGarbage(const std::string& text) {
+    if (text.empty() || text.length() > 100) return false; // Too long might be real text
+
+    int letterCount = 0;
+    int digitCount = 0;
+    int symbolCount = 0;
+    int consecutiveSymbols = 0;
+    int maxConsecutiveSymbols = 0;
+
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalpha(u)) {
+            letterCount++;
+            consecutiveSymbols = 0;
+        } else if (std::isdigit(u)) {
+            digitCount++;
+            consecutiveSymbols = 0;
+        } else if (!std::isspace(u)) {
+            symbolCount++;
+            consecutiveSymbols++;
+            maxConsecutiveSymbols = std::max(maxConsecutiveSymbols, consecutiveSymbols);
+        } else {
+            consecutiveSymbols = 0;
+        }
+    }
+
+    // If mostly symbols or too many consecutive symbols, likely garbage
+    if (symbolCount > letterCount + digitCount) return true;
+    if (maxConsecutiveSymbols >= 3) return true;
+
+    // If very short but has multiple different symbols, likely garbage
+    if (text.length() < 5 && symbolCount >= 2) return true;
+
+    return false;
+}
+
+std::string postProcessOCRText(const std::string& text, const Lexicon* lexicon) {
+    static const TextCorrector corrector(buildCorrectionRules());
+
+    // Trim, fold typographic quotes and collapse spaces
+    std::string normalized;
+    normalizeText(text, normalized);
+    if (normalized.empty()) return "";
+
+    std::string result;
+    corrector.apply(normalized, result);
+    if (lexicon) {
+        correctConfusableDigits(result, *lexicon);
+    }
+    stripEdgePunctuation(result);
+
+    // Final validation - if result looks like garbage, return empty
+    if (isLikelyGarbage(result)) {
+        return "";
+    }
+
+    return result;
+}
\ No newline at end of file
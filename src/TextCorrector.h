@@ -0,0 +1,57 @@
+#ifndef TEXTCORRECTOR_H
+#define TEXTCORRECTOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+class Lexicon;
+
+// A set of find/replace rules compiled into a byte trie and applied in a
+// single left-to-right pass. At each position the longest matching rule
+// wins; whole-word rules only match where the characters written on either
+// side are not alphanumeric. Output goes to a caller-owned buffer, so a
+// reused buffer makes correction allocation-free.
+class TextCorrector {
+public:
+    struct Rule {
+        std::string pattern;
+        std::string replacement;
+        bool wholeWord = false;
+    };
+
+    // When several rules share a pattern the first one is kept
+    explicit TextCorrector(const std::vector<Rule>& rules);
+
+    // Replaces out with the corrected text
+    void apply(std::string_view text, std::string& out) const;
+
+    size_t ruleCount() const { return m_rules.size(); }
+
+private:
+    static const int MAX_CANDIDATES = 8;
+
+    struct Candidate {
+        int rule;
+        size_t length;
+    };
+
+    int findCandidates(std::string_view text, size_t pos, Candidate* candidates) const;
+    bool nextIsAlnum(std::string_view text, size_t pos) const;
+
+    std::vector<Rule> m_rules;
+    uint8_t m_byteClass[256];           // Bytes no pattern uses share class 0
+    int m_classCount = 1;
+    std::vector<int32_t> m_next;        // m_classCount children per node, 0 = none
+    std::vector<int32_t> m_terminal;    // Rule ending at each node, -1 = none
+};
+
+// Trims, corrects common OCR confusions and rejects garbage, all with a
+// rule set compiled once per process. Digits that look like letters are
+// only replaced inside words, and only when lexicon confirms the
+// replacement; without a lexicon they are kept. Returns "" for text that
+// doesn't look like real words.
+std::string postProcessOCRText(const std::string& text, const Lexicon* lexicon = nullptr);
+
+#endif // TEXTCORRECTOR_H
\ No newline at end of file
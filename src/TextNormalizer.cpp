@@ -0,0 +1,115 @@
+#include "TextNormalizer.h"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OCR_TEXT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const char* WHITESPACE = " \t\n\r\f\v";
+
+static bool isSpecialScalar(const char* p, const char* end) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    return c >= 0x80 || (c == ' ' && p + 1 < end && p[1] == ' ');
+}
+
+// Length of the prefix of [p, end) that can be copied as-is: no byte
+// outside ASCII and no space followed by another space
+static size_t plainRun(const char* p, const char* end) {
+    const char* start = p;
+#ifdef OCR_TEXT_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    // The second load reads one byte ahead, so stop a byte early
+    while (end - p > 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        __m128i doubleSpace = _mm_and_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(next, space));
+        int mask = _mm_movemask_epi8(_mm_or_si128(bytes, doubleSpace));
+        if (mask != 0) {
+            return static_cast<size_t>(p - start) + std::countr_zero(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && !isSpecialScalar(p, end)) {
+        ++p;
+    }
+    return static_cast<size_t>(p - start);
+}
+
+// ASCII replacement for the typographic quote starting at p, if any
+static char foldQuote(const char* p, const char* end, size_t& length) {
+    unsigned char c0 = static_cast<unsigned char>(p[0]);
+    if (c0 == 0xC2 && end - p >= 2 && static_cast<unsigned char>(p[1]) == 0xB4) {
+        length = 2;                                     // ´
+        return '\'';
+    }
+    if (c0 == 0xE2 && end - p >= 3 && static_cast<unsigned char>(p[1]) == 0x80) {
+        length = 3;
+        switch (static_cast<unsigned char>(p[2])) {
+            case 0x98: case 0x99: return '\'';          // ‘ ’
+            case 0x9C: case 0x9D: case 0x9E: return '"'; // “ ” „
+        }
+    }
+    return '\0';
+}
+
+void normalizeText(std::string_view text, std::string& out) {
+    out.clear();
+    size_t first = text.find_first_not_of(WHITESPACE);
+    if (first == std::string_view::npos) {
+        return;
+    }
+    text = text.substr(first, text.find_last_not_of(WHITESPACE) - first + 1);
+    out.reserve(text.size());
+
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        size_t run = plainRun(p, end);
+        out.append(p, run);
+        p += run;
+        if (p == end) {
+            break;
+        }
+
+        if (*p == ' ') {
+            // Two or more spaces in a row
+            out.push_back(' ');
+            while (p < end && *p == ' ') {
+                ++p;
+            }
+            continue;
+        }
+
+        size_t length = 1;
+        char folded = foldQuote(p, end, length);
+        if (folded) {
+            out.push_back(folded);
+            p += length;
+        } else {
+            out.push_back(*p++);
+        }
+    }
+}
+
+void stripEdgePunctuation(std::string& text) {
+    const char* punctuation = ".,!?*-|`'\"";
+    size_t first = text.find_first_not_of(punctuation);
+    if (first == std::string::npos) {
+        text.clear();
+        return;
+    }
+    text.erase(text.find_last_not_of(punctuation) + 1);
+    text.erase(0, first);
+}
+
+const char* normalizeKernelName() {
+#ifdef OCR_TEXT_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
\ No newline at end of file
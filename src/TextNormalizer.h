@@ -0,0 +1,24 @@
+#ifndef TEXTNORMALIZER_H
+#define TEXTNORMALIZER_H
+
+#include <string>
+#include <string_view>
+
+// Clean-up shared by every consumer of Tesseract's text, before and after
+// any tool-specific corrections.
+//
+// Writes text to out with leading/trailing whitespace removed, runs of
+// spaces collapsed to one, and typographic quotes (‘ ’ ´ “ ” „) folded to
+// their ASCII forms. ASCII text is scanned 16 bytes at a time and copied
+// in bulk; only double spaces and non-ASCII bytes leave the fast path, and
+// multi-byte UTF-8 sequences other than the quotes are copied unchanged.
+void normalizeText(std::string_view text, std::string& out);
+
+// Removes the stray punctuation Tesseract tends to leave at the edges of a
+// crop (. , ! ? * - | ` ' ")
+void stripEdgePunctuation(std::string& text);
+
+// Scan kernel selected at compile time: "sse2" or "scalar"
+const char* normalizeKernelName();
+
+#endif // TEXTNORMALIZER_H
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "ThreadPool.h"
 #include <iostream>
 
-ThreadPool::ThreadPool(size_t numThreads) 
-    : m_stop(false)
+ThreadPool::ThreadPool(size_t numThreads, size_t maxQueued) 
+    : m_maxQueued(maxQueued)
+    , m_stop(false)
     , m_activeTasks(0) 
 {
     for (size_t i = 0; i < numThreads; ++i) {
@@ -38,7 +39,15 @@ void ThreadPool::workerThread() {
             
             task = std::move(m_tasks.front());
             m_tasks.pop();
+            
+            // A slot just opened up; let a parked coroutine have it first
+            if (!m_parked.empty()) {
+                std::coroutine_handle<> handle = m_parked.front();
+                m_parked.pop_front();
+                m_tasks.emplace([handle]() { handle.resume(); });
+            }
         }
+        m_spaceCondition.notify_one();
         
         task();
         
@@ -50,9 +59,22 @@ void ThreadPool::workerThread() {
     }
 }
 
+void ThreadPool::post(std::coroutine_handle<> handle) {
+    {
+        std::unique_lock<std::mutex> lock(m_queueMutex);
+        m_activeTasks++;
+        if (m_maxQueued != 0 && m_tasks.size() >= m_maxQueued) {
+            m_parked.push_back(handle);
+            return;
+        }
+        m_tasks.emplace([handle]() { handle.resume(); });
+    }
+    m_condition.notify_one();
+}
+
 void ThreadPool::waitAll() {
     std::unique_lock<std::mutex> lock(m_queueMutex);
     m_completionCondition.wait(lock, [this]() {
-        return m_tasks.empty() && m_activeTasks == 0;
+        return m_tasks.empty() && m_parked.empty() && m_activeTasks == 0;
     });
 }
\ No newline at end of file
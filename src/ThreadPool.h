@@ -8,25 +8,49 @@
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <deque>
+#include <coroutine>
 
 class ThreadPool {
 public:
-    ThreadPool(size_t numThreads);
+    // maxQueued bounds the number of tasks waiting for a worker; enqueue()
+    // blocks while the queue is full. Zero means unbounded.
+    ThreadPool(size_t numThreads, size_t maxQueued = 0);
     ~ThreadPool();
     
     template<class F>
     void enqueue(F&& task);
     
+    // Resumes a suspended coroutine on one of the workers. Unlike enqueue()
+    // this never blocks: when the queue is full the handle is parked until
+    // a worker frees a slot.
+    void post(std::coroutine_handle<> handle);
+    
+    // co_await pool.schedule() moves the calling coroutine onto this pool
+    auto schedule() {
+        struct Awaiter {
+            ThreadPool& pool;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { pool.post(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+    
     void waitAll();
+    size_t threadCount() const { return m_workers.size(); }
     
 private:
     void workerThread();
     
     std::vector<std::thread> m_workers;
     std::queue<std::function<void()>> m_tasks;
+    std::deque<std::coroutine_handle<>> m_parked;
     
     std::mutex m_queueMutex;
     std::condition_variable m_condition;
+    std::condition_variable m_spaceCondition;
+    size_t m_maxQueued;
     std::atomic<bool> m_stop;
     std::atomic<int> m_activeTasks;
     std::condition_variable m_completionCondition;
@@ -36,6 +60,9 @@ template<class F>
 void ThreadPool::enqueue(F&& task) {
     {
         std::unique_lock<std::mutex> lock(m_queueMutex);
+        m_spaceCondition.wait(lock, [this]() {
+            return m_maxQueued == 0 || m_tasks.size() < m_maxQueued;
+        });
         m_tasks.emplace(std::forward<F>(task));
         m_activeTasks++;
     }
@@ -0,0 +1,117 @@
+#include "TrainedData.h"
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Where packaged Tesseract installs keep their models
+static const char* TESSDATA_LOCATIONS[] = {
+    "/usr/share/tesseract-ocr/5/tessdata",
+    "/usr/share/tesseract-ocr/4.00/tessdata",
+    "/usr/share/tessdata",
+    "/usr/local/share/tessdata",
+    "/opt/homebrew/share/tessdata"
+};
+
+static std::string findModel(const std::string& tessdataPath, const std::string& language) {
+    std::vector<std::filesystem::path> directories;
+    if (!tessdataPath.empty()) {
+        directories.push_back(tessdataPath);
+    } else {
+        if (const char* prefix = std::getenv("TESSDATA_PREFIX")) {
+            directories.push_back(prefix);
+            directories.push_back(std::filesystem::path(prefix) / "tessdata");
+        }
+        directories.insert(directories.end(), std::begin(TESSDATA_LOCATIONS), std::end(TESSDATA_LOCATIONS));
+    }
+
+    std::error_code error;
+    for (const auto& directory : directories) {
+        std::filesystem::path candidate = directory / (language + ".traineddata");
+        if (std::filesystem::is_regular_file(candidate, error)) {
+            return candidate.string();
+        }
+    }
+    return "";
+}
+
+TrainedData::~TrainedData() {
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+#else
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_dataSize);
+    }
+#endif
+}
+
+std::string TrainedData::directory() const {
+    return std::filesystem::path(m_path).parent_path().string();
+}
+
+std::shared_ptr<const TrainedData> TrainedData::load(const std::string& tessdataPath, const std::string& language) {
+    std::string path = findModel(tessdataPath, language);
+    if (path.empty()) {
+        return nullptr;
+    }
+
+    std::shared_ptr<TrainedData> model(new TrainedData());
+    model->m_path = path;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Cannot open model " << path << std::endl;
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && fileSize.QuadPart <= INT_MAX) {
+        model->m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (model->m_mapping) {
+            model->m_data = static_cast<const char*>(MapViewOfFile(model->m_mapping, FILE_MAP_READ, 0, 0, 0));
+            model->m_dataSize = static_cast<size_t>(fileSize.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Cannot open model " << path << std::endl;
+        return nullptr;
+    }
+    // Tesseract takes the buffer size as an int
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0 && status.st_size <= INT_MAX) {
+        void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+        if (data != MAP_FAILED) {
+            model->m_data = static_cast<const char*>(data);
+            model->m_dataSize = static_cast<size_t>(status.st_size);
+        }
+    }
+    ::close(file);
+#endif
+
+    if (!model->m_data) {
+        std::cerr << "Cannot map model " << path << std::endl;
+        return nullptr;
+    }
+    return model;
+}
\ No newline at end of file
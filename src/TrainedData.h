@@ -0,0 +1,39 @@
+#ifndef TRAINEDDATA_H
+#define TRAINEDDATA_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// A Tesseract language model (<language>.traineddata), memory-mapped once
+// so every engine can be initialized from the same pages instead of each
+// one finding, opening and reading the file itself. Tesseract still builds
+// its own copy of the model per engine; what is shared is the file.
+class TrainedData {
+public:
+    ~TrainedData();
+
+    // Looks in tessdataPath, or when that is empty in TESSDATA_PREFIX and
+    // the usual install locations. nullptr if the model isn't found there,
+    // in which case Tesseract can still be left to find it itself.
+    static std::shared_ptr<const TrainedData> load(const std::string& tessdataPath,
+                                                   const std::string& language = "eng");
+
+    const char* data() const { return m_data; }
+    int size() const { return static_cast<int>(m_dataSize); }
+    const std::string& path() const { return m_path; }
+    // The tessdata directory the model was found in
+    std::string directory() const;
+
+private:
+    TrainedData() = default;
+
+    const char* m_data = nullptr;
+    size_t m_dataSize = 0;
+    std::string m_path;
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+};
+
+#endif // TRAINEDDATA_H
\ No newline at end of file
@@ -0,0 +1,713 @@
+#include "WorkerProcess.h"
+#include <iostream>
+#include <stdexcept>
+
+static std::atomic<uint64_t> g_crashes{0};
+
+uint64_t WorkerProcess::crashCount() {
+    return g_crashes.load();
+}
+
+static const size_t ARENA_ALIGNMENT = 4096;
+
+SharedImageArena::SharedImageArena(int fd, char* base, size_t size)
+    : m_fd(fd)
+    , m_base(base)
+    , m_size(size) {
+    m_free[0] = size;
+}
+
+void* SharedImageArena::allocate(size_t size) {
+    size_t bytes = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto block = m_free.begin(); block != m_free.end(); ++block) {
+        if (block->second < bytes) {
+            continue;
+        }
+        size_t offset = block->first;
+        size_t rest = block->second - bytes;
+        m_free.erase(block);
+        if (rest > 0) {
+            m_free[offset + bytes] = rest;
+        }
+        m_used[offset] = bytes;
+        return m_base + offset;
+    }
+    return nullptr;
+}
+
+void SharedImageArena::deallocate(void* ptr) {
+    size_t offset = offsetOf(ptr);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto used = m_used.find(offset);
+    if (used == m_used.end()) {
+        return;
+    }
+    size_t bytes = used->second;
+    m_used.erase(used);
+
+    auto next = m_free.find(offset + bytes);
+    if (next != m_free.end()) {
+        bytes += next->second;
+        m_free.erase(next);
+    }
+    auto block = m_free.emplace(offset, bytes).first;
+    if (block != m_free.begin()) {
+        auto previous = std::prev(block);
+        if (previous->first + previous->second == offset) {
+            previous->second += bytes;
+            m_free.erase(block);
+        }
+    }
+}
+
+#ifndef _WIN32
+
+#include "PixMemoryPool.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+enum class WorkerProcess::Command : uint8_t {
+    Recognize = 1,
+    RecognizeWithConfidence,
+    AnalyzeLayout,
+    RecognizeRegion
+};
+
+// Sent by the worker once it is initialized, and after every call
+static const uint8_t WORKER_READY = 'R';
+static const uint8_t WORKER_DONE = 'D';
+
+// The start of the shared memory. Each side only touches it while it is
+// its turn, which the socket hands back and forth; progress is the one
+// field written while the server waits.
+struct WorkerChannel {
+    // Written once by the server, before the first worker starts
+    char profile[64];
+    int32_t engineMode;
+    char tessdataPath[1024];
+    int32_t cascadeEnabled;
+    int32_t minConfidence;
+    int32_t fastTextHeight;
+    char fastModelPath[1024];
+    int32_t warmUp;
+
+    // Request
+    char filename[256];
+    int32_t pageSegMode;
+    int32_t textHeight;
+    int32_t timeoutMs;              // 0 = unlimited
+    int32_t reportProgress;
+    TextRegion region;
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+    int32_t spp;
+    int32_t xres;
+    int32_t yres;
+    uint64_t imageBytes;
+    int32_t imageShared;            // Raster at imageOffset in the SharedImageArena,
+    uint64_t imageOffset;           // otherwise at CHANNEL_HEADER_BYTES
+
+    // Reply, text or regions at CHANNEL_HEADER_BYTES
+    int32_t expired;
+    int32_t confidence;
+    CascadeResult cascade;
+    uint64_t textBytes;
+    uint32_t regionCount;
+
+    std::atomic<int32_t> progress;  // Percent recognized so far, -1 before any
+};
+
+static const size_t CHANNEL_HEADER_BYTES = 4096;
+// Address space only: the pages are allocated as images touch them, so
+// this just bounds the largest raster a worker can take (8k x 8k RGBA)
+static const size_t CHANNEL_BYTES = 256 * 1024 * 1024;
+static const size_t CHANNEL_DATA_BYTES = CHANNEL_BYTES - CHANNEL_HEADER_BYTES;
+static_assert(sizeof(WorkerChannel) <= CHANNEL_HEADER_BYTES, "WorkerChannel must fit its header");
+
+// How often a waiting server forwards progress, and how long past its
+// deadline a worker may take before it is considered hung
+static const int PROGRESS_POLL_MS = 100;
+static const auto HANG_GRACE = std::chrono::seconds(10);
+
+static char* channelData(WorkerChannel* channel) {
+    return reinterpret_cast<char*>(channel) + CHANNEL_HEADER_BYTES;
+}
+
+static void copyString(char* destination, size_t size, const std::string& source) {
+    size_t length = std::min(source.size(), size - 1);
+    std::memcpy(destination, source.data(), length);
+    destination[length] = '\0';
+}
+
+static bool sendByte(int socket, uint8_t byte) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;            // SO_NOSIGPIPE is set on the socket instead
+#endif
+    while (true) {
+        ssize_t sent = send(socket, &byte, 1, flags);
+        if (sent == 1) {
+            return true;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+// 0 when the other end has closed the socket or it failed
+static uint8_t receiveByte(int socket) {
+    while (true) {
+        uint8_t byte = 0;
+        ssize_t received = recv(socket, &byte, 1, 0);
+        if (received == 1) {
+            return byte;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        return 0;
+    }
+}
+
+static std::string currentExecutable() {
+    char path[PATH_MAX];
+#ifdef __APPLE__
+    uint32_t size = sizeof(path);
+    if (_NSGetExecutablePath(path, &size) == 0) {
+        return path;
+    }
+    return "";
+#else
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0) {
+        return "";
+    }
+    path[length] = '\0';
+    return path;
+#endif
+}
+
+SharedImageArena* SharedImageArena::create(size_t bytes) {
+    std::string name = "/ocr-images-" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        std::cerr << "Cannot create shared memory for images: " << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    shm_unlink(name.c_str());
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) {
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory for images: " << std::strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    return new SharedImageArena(fd, static_cast<char*>(mapping), bytes);
+}
+
+WorkerProcess::WorkerProcess(const Setup& setup)
+    : m_setup(setup)
+    , m_channel(nullptr)
+    , m_channelFd(-1)
+    , m_socket(-1)
+    , m_pid(-1)
+    , m_alive(false) {
+}
+
+WorkerProcess::~WorkerProcess() {
+    stop();
+    if (m_channel) {
+        munmap(m_channel, CHANNEL_BYTES);
+    }
+    if (m_channelFd >= 0) {
+        close(m_channelFd);
+    }
+}
+
+bool WorkerProcess::start() {
+    std::string executable = currentExecutable();
+    if (executable.empty()) {
+        std::cerr << "Cannot find the server executable to start an OCR worker" << std::endl;
+        return false;
+    }
+
+    // The channel outlives restarts; a fresh worker just maps it again
+    if (!m_channel) {
+        static std::atomic<int> channelCount{0};
+        std::string name = "/ocr-worker-" + std::to_string(getpid()) + "-" + std::to_string(channelCount++);
+        m_channelFd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (m_channelFd < 0) {
+            std::cerr << "Cannot create shared memory for an OCR worker: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        // Only the descriptors keep it alive from here on
+        shm_unlink(name.c_str());
+        void* mapping = MAP_FAILED;
+        if (ftruncate(m_channelFd, CHANNEL_BYTES) == 0) {
+            mapping = mmap(nullptr, CHANNEL_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, m_channelFd, 0);
+        }
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Cannot map shared memory for an OCR worker: " << std::strerror(errno) << std::endl;
+            close(m_channelFd);
+            m_channelFd = -1;
+            return false;
+        }
+        m_channel = new (mapping) WorkerChannel();
+        copyString(m_channel->profile, sizeof(m_channel->profile), m_setup.profile->name);
+        m_channel->engineMode = m_setup.engine.engineMode;
+        copyString(m_channel->tessdataPath, sizeof(m_channel->tessdataPath), m_setup.engine.tessdataPath);
+        m_channel->cascadeEnabled = m_setup.cascade.enabled;
+        m_channel->minConfidence = m_setup.cascade.minConfidence;
+        m_channel->fastTextHeight = m_setup.cascade.fastTextHeight;
+        copyString(m_channel->fastModelPath, sizeof(m_channel->fastModelPath), m_setup.cascade.fastModelPath);
+        m_channel->warmUp = m_setup.warmUp;
+    }
+
+    // Other threads may start workers too; only this worker should inherit
+    // its socket, or a crash would never close it
+    int sockets[2];
+#ifdef SOCK_CLOEXEC
+    int socketType = SOCK_STREAM | SOCK_CLOEXEC;
+#else
+    int socketType = SOCK_STREAM;
+#endif
+    if (socketpair(AF_UNIX, socketType, 0, sockets) != 0) {
+        std::cerr << "Cannot create a socket for an OCR worker: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    int noSigPipe = 1;
+    setsockopt(sockets[0], SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    // Everything exec needs is prepared before fork: the server has other
+    // threads, so the child may only make async-signal-safe calls
+    std::string socketArg = std::to_string(sockets[1]);
+    std::string channelArg = std::to_string(m_channelFd);
+    int imagesFd = m_setup.images ? m_setup.images->fd() : -1;
+    std::string imagesArg = std::to_string(imagesFd);
+    const char* argv[] = {executable.c_str(), "--ocr-worker", socketArg.c_str(), channelArg.c_str(),
+                          imagesArg.c_str(), nullptr};
+    pid_t pid = fork();
+    if (pid == 0) {
+        fcntl(sockets[1], F_SETFD, 0);
+        fcntl(m_channelFd, F_SETFD, 0);
+        if (imagesFd >= 0) {
+            fcntl(imagesFd, F_SETFD, 0);
+        }
+        execv(argv[0], const_cast<char* const*>(argv));
+        _exit(127);
+    }
+    close(sockets[1]);
+    if (pid < 0) {
+        std::cerr << "Cannot start an OCR worker: " << std::strerror(errno) << std::endl;
+        close(sockets[0]);
+        return false;
+    }
+    m_socket = sockets[0];
+    m_pid = pid;
+    return true;
+}
+
+bool WorkerProcess::waitReady() {
+    if (m_socket < 0) {
+        return false;
+    }
+    if (receiveByte(m_socket) != WORKER_READY) {
+        std::cerr << "OCR worker " << m_pid << " failed to initialize" << std::endl;
+        stop();
+        return false;
+    }
+    m_alive = true;
+    return true;
+}
+
+bool WorkerProcess::restart() {
+    stop();
+    return start() && waitReady();
+}
+
+// Closing the socket tells an idle worker to exit
+void WorkerProcess::stop() {
+    m_alive = false;
+    if (m_socket >= 0) {
+        close(m_socket);
+        m_socket = -1;
+    }
+    if (m_pid <= 0) {
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (waitpid(m_pid, nullptr, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            kill(m_pid, SIGKILL);
+            waitpid(m_pid, nullptr, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    m_pid = -1;
+}
+
+void WorkerProcess::died(const std::string& filename, const char* how) {
+    m_alive = false;
+    close(m_socket);
+    m_socket = -1;
+    int status = 0;
+    while (waitpid(m_pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    g_crashes++;
+
+    std::cerr << "OCR worker " << m_pid << " " << how << " on " << filename;
+    if (WIFSIGNALED(status)) {
+        std::cerr << " (signal " << WTERMSIG(status) << ")";
+    }
+    std::cerr << ", it will be replaced" << std::endl;
+    m_pid = -1;
+    throw std::runtime_error(std::string("OCR worker process ") + how);
+}
+
+void WorkerProcess::call(Command command, Pix* image, const std::string& filename, RecognitionMonitor* monitor) {
+    if (!m_alive) {
+        throw std::runtime_error("OCR worker process is not running");
+    }
+    WorkerChannel& channel = *m_channel;
+
+    // An image decoded into the arena is already in the worker's memory;
+    // anything else takes one copy. Either way the worker recognizes it in
+    // place.
+    Pix* converted = pixGetColormap(image) ? pixRemoveColormap(image, REMOVE_CMAP_BASED_ON_SRC) : nullptr;
+    Pix* source = converted ? converted : image;
+    size_t bytes = static_cast<size_t>(pixGetWpl(source)) * 4 * pixGetHeight(source);
+    channel.imageShared = m_setup.images && m_setup.images->owns(pixGetData(source));
+    if (channel.imageShared) {
+        channel.imageOffset = m_setup.images->offsetOf(pixGetData(source));
+    } else if (bytes > CHANNEL_DATA_BYTES) {
+        if (converted) {
+            pixDestroy(&converted);
+        }
+        throw std::runtime_error("image too large for an OCR worker process");
+    } else {
+        std::memcpy(channelData(&channel), pixGetData(source), bytes);
+    }
+    channel.imageBytes = bytes;
+    channel.width = pixGetWidth(source);
+    channel.height = pixGetHeight(source);
+    channel.depth = pixGetDepth(source);
+    channel.spp = pixGetSpp(source);
+    channel.xres = pixGetXRes(source);
+    channel.yres = pixGetYRes(source);
+    if (converted) {
+        pixDestroy(&converted);
+    }
+
+    copyString(channel.filename, sizeof(channel.filename), filename);
+    auto now = std::chrono::steady_clock::now();
+    // Tesseract is cancelled at the deadline, so a worker well past it is
+    // stuck somewhere it can't be cancelled from. Calls without a deadline
+    // (layout analysis, or no --image-timeout) still get the ceiling.
+    auto hungAt = now + std::chrono::milliseconds(m_setup.hangTimeoutMs);
+    channel.timeoutMs = 0;
+    channel.reportProgress = monitor && monitor->onProgress;
+    if (monitor && monitor->deadline != std::chrono::steady_clock::time_point::max()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(monitor->deadline - now);
+        channel.timeoutMs = static_cast<int32_t>(std::max<long long>(1, remaining.count()));
+        hungAt = std::min(hungAt, monitor->deadline + HANG_GRACE);
+    }
+    channel.progress = -1;
+    channel.expired = 0;
+
+    if (!sendByte(m_socket, static_cast<uint8_t>(command))) {
+        died(filename, "stopped accepting work");
+    }
+
+    int lastProgress = -1;
+    while (true) {
+        pollfd waiting{m_socket, POLLIN, 0};
+        int ready = poll(&waiting, 1, PROGRESS_POLL_MS);
+        if (ready > 0) {
+            if (receiveByte(m_socket) != WORKER_DONE) {
+                died(filename, "crashed");
+            }
+            break;
+        }
+        if (ready < 0 && errno != EINTR) {
+            died(filename, "became unreachable");
+        }
+
+        int progress = channel.progress.load();
+        if (progress != lastProgress && progress >= 0 && channel.reportProgress) {
+            monitor->onProgress(progress);
+            lastProgress = progress;
+        }
+        if (std::chrono::steady_clock::now() > hungAt) {
+            kill(m_pid, SIGKILL);
+            died(filename, "stopped responding");
+        }
+    }
+
+    if (monitor && channel.expired) {
+        monitor->expired = true;
+    }
+}
+
+static std::string replyText(WorkerChannel* channel) {
+    return std::string(channelData(channel), std::min<uint64_t>(channel->textBytes, CHANNEL_DATA_BYTES));
+}
+
+std::string WorkerProcess::recognize(Pix* image, const std::string& filename, tesseract::PageSegMode pageSegMode,
+                                     int textHeight, CascadeResult* cascade, RecognitionMonitor* monitor) {
+    m_channel->pageSegMode = pageSegMode;
+    m_channel->textHeight = textHeight;
+    call(Command::Recognize, image, filename, monitor);
+    if (cascade) {
+        *cascade = m_channel->cascade;
+    }
+    // The worker's own totals die with it
+    OCRProcessor::recordCascade(m_channel->cascade);
+    return replyText(m_channel);
+}
+
+std::string WorkerProcess::recognizeWithConfidence(Pix* image, const std::string& filename,
+                                                   tesseract::PageSegMode pageSegMode, int& confidence,
+                                                   RecognitionMonitor* monitor) {
+    m_channel->pageSegMode = pageSegMode;
+    call(Command::RecognizeWithConfidence, image, filename, monitor);
+    confidence = m_channel->confidence;
+    return replyText(m_channel);
+}
+
+std::vector<TextRegion> WorkerProcess::analyzeLayout(Pix* image, const std::string& filename) {
+    call(Command::AnalyzeLayout, image, filename, nullptr);
+    const TextRegion* regions = reinterpret_cast<const TextRegion*>(channelData(m_channel));
+    return std::vector<TextRegion>(regions, regions + m_channel->regionCount);
+}
+
+std::string WorkerProcess::recognizeRegion(Pix* image, const TextRegion& region, const std::string& filename,
+                                           RecognitionMonitor* monitor) {
+    m_channel->region = region;
+    call(Command::RecognizeRegion, image, filename, monitor);
+    return replyText(m_channel);
+}
+
+static void writeText(WorkerChannel* channel, const std::string& text) {
+    channel->textBytes = std::min<uint64_t>(text.size(), CHANNEL_DATA_BYTES);
+    std::memcpy(channelData(channel), text.data(), channel->textBytes);
+}
+
+int WorkerProcess::serve(int socketFd, int channelFd, int imagesFd) {
+    // Ctrl+C reaches the whole process group; the server shuts its workers
+    // down itself, by closing their sockets
+    std::signal(SIGINT, SIG_IGN);
+
+    void* mapping = mmap(nullptr, CHANNEL_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, channelFd, 0);
+    close(channelFd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "OCR worker cannot map its shared memory: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    WorkerChannel* channel = static_cast<WorkerChannel*>(mapping);
+
+    char* images = nullptr;
+    size_t imagesSize = 0;
+    if (imagesFd >= 0) {
+        struct stat info;
+        void* imagesMapping = MAP_FAILED;
+        if (fstat(imagesFd, &info) == 0) {
+            imagesSize = static_cast<size_t>(info.st_size);
+            imagesMapping = mmap(nullptr, imagesSize, PROT_READ | PROT_WRITE, MAP_SHARED, imagesFd, 0);
+        }
+        close(imagesFd);
+        if (imagesMapping == MAP_FAILED) {
+            std::cerr << "OCR worker cannot map the server's images: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        images = static_cast<char*>(imagesMapping);
+    }
+
+    PixMemoryPool::install();
+
+    const OCRProfile* profile = findProfile(channel->profile);
+    if (!profile) {
+        std::cerr << "OCR worker given an unknown profile: " << channel->profile << std::endl;
+        return 1;
+    }
+    EngineOptions engine;
+    engine.engineMode = static_cast<tesseract::OcrEngineMode>(channel->engineMode);
+    engine.tessdataPath = channel->tessdataPath;
+    engine.model = TrainedData::load(engine.tessdataPath);
+    CascadeOptions cascade;
+    cascade.enabled = channel->cascadeEnabled != 0;
+    cascade.minConfidence = channel->minConfidence;
+    cascade.fastTextHeight = channel->fastTextHeight;
+    cascade.fastModelPath = channel->fastModelPath;
+    if (cascade.enabled && !cascade.fastModelPath.empty()) {
+        cascade.fastModel = TrainedData::load(cascade.fastModelPath);
+    }
+
+    OCRProcessor processor;
+    if (!processor.initialize(*profile, cascade, engine)) {
+        return 1;
+    }
+    if (channel->warmUp) {
+        processor.warmUp();
+    }
+    if (!sendByte(socketFd, WORKER_READY)) {
+        return 1;
+    }
+
+    while (true) {
+        uint8_t command = receiveByte(socketFd);
+        if (command == 0) {
+            return 0;
+        }
+
+        // The raster stays where the server put it
+        char* raster = channelData(channel);
+        if (channel->imageShared) {
+            if (!images || channel->imageOffset > imagesSize ||
+                channel->imageBytes > imagesSize - channel->imageOffset) {
+                std::cerr << "OCR worker given an image outside the shared images" << std::endl;
+                return 1;
+            }
+            raster = images + channel->imageOffset;
+        }
+        Pix* image = pixCreateHeader(channel->width, channel->height, channel->depth);
+        pixSetData(image, reinterpret_cast<l_uint32*>(raster));
+        pixSetSpp(image, channel->spp);
+        pixSetResolution(image, channel->xres, channel->yres);
+
+        RecognitionMonitor monitor;
+        monitor.start(channel->timeoutMs);
+        if (channel->reportProgress) {
+            monitor.onProgress = [channel](int percent) { channel->progress = percent; };
+        }
+        std::string filename = channel->filename;
+        auto pageSegMode = static_cast<tesseract::PageSegMode>(channel->pageSegMode);
+
+        // Replies overwrite a copied raster, so they are only written once
+        // the image is done with
+        switch (static_cast<Command>(command)) {
+            case Command::Recognize: {
+                CascadeResult result;
+                std::string text = processor.recognize(image, filename, pageSegMode, channel->textHeight,
+                                                       &result, &monitor);
+                channel->cascade = result;
+                writeText(channel, text);
+                break;
+            }
+            case Command::RecognizeWithConfidence: {
+                int confidence = -1;
+                std::string text = processor.recognizeWithConfidence(image, filename, pageSegMode, confidence,
+                                                                     &monitor);
+                channel->confidence = confidence;
+                writeText(channel, text);
+                break;
+            }
+            case Command::AnalyzeLayout: {
+                std::vector<TextRegion> regions = processor.analyzeLayout(image, filename);
+                size_t count = std::min(regions.size(), CHANNEL_DATA_BYTES / sizeof(TextRegion));
+                std::memcpy(channelData(channel), regions.data(), count * sizeof(TextRegion));
+                channel->regionCount = static_cast<uint32_t>(count);
+                break;
+            }
+            case Command::RecognizeRegion: {
+                writeText(channel, processor.recognizeRegion(image, channel->region, filename, &monitor));
+                break;
+            }
+            default:
+                std::cerr << "OCR worker received an unknown command: " << static_cast<int>(command) << std::endl;
+                break;
+        }
+        channel->expired = monitor.expired;
+
+        pixSetData(image, nullptr);
+        pixDestroy(&image);
+
+        if (!sendByte(socketFd, WORKER_DONE)) {
+            return 1;
+        }
+    }
+}
+
+#else
+
+SharedImageArena* SharedImageArena::create(size_t) {
+    return nullptr;
+}
+
+WorkerProcess::WorkerProcess(const Setup& setup)
+    : m_setup(setup)
+    , m_channel(nullptr)
+    , m_channelFd(-1)
+    , m_socket(-1)
+    , m_pid(-1)
+    , m_alive(false) {
+}
+
+WorkerProcess::~WorkerProcess() {
+}
+
+bool WorkerProcess::start() {
+    std::cerr << "OCR worker processes are not supported on Windows" << std::endl;
+    return false;
+}
+
+bool WorkerProcess::waitReady() {
+    return false;
+}
+
+bool WorkerProcess::restart() {
+    return false;
+}
+
+std::string WorkerProcess::recognize(Pix*, const std::string&, tesseract::PageSegMode, int, CascadeResult*,
+                                     RecognitionMonitor*) {
+    throw std::runtime_error("OCR worker processes are not supported on Windows");
+}
+
+std::string WorkerProcess::recognizeWithConfidence(Pix*, const std::string&, tesseract::PageSegMode, int&,
+                                                   RecognitionMonitor*) {
+    throw std::runtime_error("OCR worker processes are not supported on Windows");
+}
+
+std::vector<TextRegion> WorkerProcess::analyzeLayout(Pix*, const std::string&) {
+    throw std::runtime_error("OCR worker processes are not supported on Windows");
+}
+
+std::string WorkerProcess::recognizeRegion(Pix*, const TextRegion&, const std::string&, RecognitionMonitor*) {
+    throw std::runtime_error("OCR worker processes are not supported on Windows");
+}
+
+int WorkerProcess::serve(int, int, int) {
+    return 1;
+}
+
+#endif
\ No newline at end of file
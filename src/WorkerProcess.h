@@ -0,0 +1,123 @@
+#ifndef WORKERPROCESS_H
+#define WORKERPROCESS_H
+
+#include "OCRProcessor.h"
+#include "PixMemoryPool.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct WorkerChannel;
+
+// Shared memory that the server decodes images into (through
+// PixMemoryPool::setArena) and every worker process maps, so an image
+// reaches a worker without being copied. First-fit blocks, page aligned.
+// Pages stay allocated once touched, so it holds on to its peak use; a
+// full arena just leaves images to the ordinary pool.
+class SharedImageArena : public PixArena {
+public:
+    // nullptr if the memory can't be created, or on Windows. Never freed:
+    // a Pix in it may outlive whatever created it.
+    static SharedImageArena* create(size_t bytes);
+
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    bool owns(const void* ptr) const override {
+        return ptr >= m_base && ptr < m_base + m_size;
+    }
+
+    int fd() const { return m_fd; }
+    size_t offsetOf(const void* ptr) const { return static_cast<const char*>(ptr) - m_base; }
+
+private:
+    SharedImageArena(int fd, char* base, size_t size);
+
+    int m_fd;
+    char* m_base;
+    size_t m_size;
+    std::mutex m_mutex;
+    std::map<size_t, size_t> m_free;                // Offset -> bytes, neighbours merged
+    std::unordered_map<size_t, size_t> m_used;      // Offset -> bytes
+};
+
+// An OCRProcessor in a process of its own, so a Tesseract crash on one
+// image takes down that process rather than the server. The two take
+// turns over a socket, and a closed socket means the worker died.
+//
+// Images reach the worker through shared memory rather than the socket.
+// With Setup::images, images decoded into that arena are recognized where
+// they are; anything else (a retry's alternate preprocessing, a full
+// arena) is copied into memory the server shares with this worker alone.
+// Every call handles one image at a time, like an OCRProcessor, so that
+// memory is a single-slot mailbox rather than a ring buffer of requests:
+// a queue in front of one Tesseract instance would only add latency.
+//
+// Methods match OCRProcessor's, except that they throw std::runtime_error
+// when the worker dies or stops responding: it is killed shortly after a
+// monitor's deadline, and after Setup::hangTimeoutMs in any case. A dead
+// worker stays dead until restart().
+//
+// POSIX only: on Windows start() always fails.
+class WorkerProcess {
+public:
+    struct Setup {
+        const OCRProfile* profile = nullptr;
+        EngineOptions engine;       // The model is loaded by the worker itself
+        CascadeOptions cascade;
+        bool warmUp = true;
+        int hangTimeoutMs = 5 * 60 * 1000;  // Longest any call may take, with or without
+                                            // a deadline, before the worker is killed
+        SharedImageArena* images = nullptr; // Where the server decodes images, if anywhere
+    };
+
+    explicit WorkerProcess(const Setup& setup);
+    ~WorkerProcess();
+
+    WorkerProcess(const WorkerProcess&) = delete;
+    WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+    // Launches the worker without waiting for it, so several can
+    // initialize at once; waitReady() waits until this one has
+    bool start();
+    bool waitReady();
+    bool alive() const { return m_alive; }
+    // Ends the worker, if it is running, and starts and waits for a new one
+    bool restart();
+
+    std::string recognize(Pix* image, const std::string& filename, tesseract::PageSegMode pageSegMode,
+                          int textHeight, CascadeResult* cascade, RecognitionMonitor* monitor);
+    std::string recognizeWithConfidence(Pix* image, const std::string& filename,
+                                        tesseract::PageSegMode pageSegMode, int& confidence,
+                                        RecognitionMonitor* monitor);
+    std::vector<TextRegion> analyzeLayout(Pix* image, const std::string& filename);
+    std::string recognizeRegion(Pix* image, const TextRegion& region, const std::string& filename,
+                                RecognitionMonitor* monitor);
+
+    // Workers that died or hung since startup, across all instances
+    static uint64_t crashCount();
+
+    // The worker side: serves calls over socketFd until the server closes
+    // it. imagesFd is the SharedImageArena, or -1. Returns the process
+    // exit status.
+    static int serve(int socketFd, int channelFd, int imagesFd);
+
+private:
+    enum class Command : uint8_t;
+
+    void call(Command command, Pix* image, const std::string& filename, RecognitionMonitor* monitor);
+    void stop();
+    void died(const std::string& filename, const char* how);
+
+    Setup m_setup;
+    WorkerChannel* m_channel;
+    int m_channelFd;
+    int m_socket;
+    int m_pid;
+    bool m_alive;
+};
+
+#endif // WORKERPROCESS_H
\ No newline at end of file